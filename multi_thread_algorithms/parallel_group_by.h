@@ -0,0 +1,282 @@
+//
+// Created by Charles Green on 10/28/25.
+//
+
+#ifndef PARALLEL_GROUP_BY_H
+#define PARALLEL_GROUP_BY_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "../my_thread_pool/thread_pool_demo01.h"
+
+/**
+ * An aggregate folds the values of one group into a State:
+ *  - init() is the state of an empty group;
+ *  - update(state, value) adds one row;
+ *  - merge(state, other) adds the state of another part of the same group, it must agree with update, i.e. the
+ *    result may not depend on how the rows of a group were split.
+ * Any type with these members plugs into ParallelGroupBy, SumAggregate and friends below are the usual ones.
+ */
+template <typename Agg, typename VT>
+concept GroupByAggregate = requires(const Agg& agg, typename Agg::State& state, const typename Agg::State& other,
+    const VT& value) {
+    { agg.init() } -> std::convertible_to<typename Agg::State>;
+    agg.update(state, value);
+    agg.merge(state, other);
+};
+
+template <typename VT>
+struct SumAggregate {
+    using State = VT;
+    State init() const { return VT(); }
+    void update(State& state, const VT& value) const { state += value; }
+    void merge(State& state, const State& other) const { state += other; }
+};
+
+template <typename VT>
+struct CountAggregate {
+    using State = size_t;
+    State init() const { return 0; }
+    void update(State& state, const VT&) const { ++state; }
+    void merge(State& state, const State& other) const { state += other; }
+};
+
+template <typename VT>
+struct MinAggregate {
+    using State = VT;
+    State init() const { return std::numeric_limits<VT>::max(); }
+    void update(State& state, const VT& value) const { state = std::min(state, value); }
+    void merge(State& state, const State& other) const { state = std::min(state, other); }
+};
+
+template <typename VT>
+struct MaxAggregate {
+    using State = VT;
+    State init() const { return std::numeric_limits<VT>::lowest(); }
+    void update(State& state, const VT& value) const { state = std::max(state, value); }
+    void merge(State& state, const State& other) const { state = std::max(state, other); }
+};
+
+/**
+ * Group (key, value) rows by key and fold each group with Agg, on the threads of a ThreadPoolDemo01, without any
+ * shared table or lock on the hot path:
+ *  - scan: TASK_NUM tasks claim CHUNK_ROWS rows at a time from an atomic cursor (so a slow worker does not hold the
+ *    others up) and fold them into a small open-addressing table owned by the task. Hot keys collapse there while the
+ *    table stays in cache. Once the table is half full it is spilled: every group goes to one of 2^PARTITION_BITS
+ *    buffers of the task, picked by the high bits of the key's hash, and the table starts over;
+ *  - merge: one task per partition merges that partition's buffers from all scan tasks into its own table. No two
+ *    tasks ever touch the same group, so again nothing is shared.
+ * The calling thread runs pool tasks while it waits. KT and State must be default constructible. The result is in no
+ * particular order.
+ */
+template <typename KT, typename VT, typename Agg, typename Hash = std::hash<KT>> requires GroupByAggregate<Agg, VT>
+class ParallelGroupBy {
+public:
+    using State = typename Agg::State;
+
+private:
+    // a group on its way from a scan task to a merge task, the hash goes along so it is computed once per row
+    struct Partial {
+        uint64_t hash_;
+        KT key_;
+        State state_;
+    };
+
+    // linear probing over a power of two, a hash of 0 marks an empty slot
+    class FlatTable {
+        std::vector<Partial> slots_;
+        size_t mask_;
+        size_t size_;
+    public:
+        explicit FlatTable(size_t capacity): slots_(capacity), mask_(capacity - 1), size_(0) {}
+
+        // the state for key, created by init if the key is new
+        State& find_or_insert(uint64_t hash, const KT& key, const Agg& agg) {
+            size_t pos = hash & mask_;
+            while(true) {
+                Partial& slot = slots_[pos];
+                if(slot.hash_ == 0) {
+                    slot.hash_ = hash;
+                    slot.key_ = key;
+                    slot.state_ = agg.init();
+                    ++size_;
+                    return slot.state_;
+                }
+                if(slot.hash_ == hash && slot.key_ == key) {
+                    return slot.state_;
+                }
+                pos = (pos + 1) & mask_;
+            }
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        size_t capacity() const {
+            return slots_.size();
+        }
+
+        // hand every group to func and leave the table empty
+        template <typename Func>
+        void drain(Func func) {
+            for(Partial& slot : slots_) {
+                if(slot.hash_ != 0) {
+                    func(std::move(slot));
+                    slot.hash_ = 0;
+                }
+            }
+            size_ = 0;
+        }
+    };
+
+    ThreadPoolDemo01& pool_;
+    Agg agg_;
+    Hash hasher_;
+    const size_t PARTITION_BITS;
+    const size_t TASK_NUM;
+    const size_t CHUNK_ROWS;
+    // 2^14 slots, small enough for L2 with the usual key and state sizes
+    static constexpr size_t LOCAL_CAPACITY = 1 << 14;
+
+    // std::hash of an integer is the identity, spread it so that both the low and the high bits are usable
+    uint64_t hashOf(const KT& key) const {
+        uint64_t hash = hasher_(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        // 0 means empty
+        return hash | 1;
+    }
+
+    size_t partitionOf(uint64_t hash) const {
+        return PARTITION_BITS == 0 ? 0 : hash >> (64 - PARTITION_BITS);
+    }
+
+    static size_t roundUpPowerOfTwo(size_t n) {
+        size_t ret = 1;
+        while(ret < n) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+    // wait for every future, running pool tasks meanwhile so the caller is not just blocked
+    void helpUntilReady(std::vector<std::future<void>>& futures) {
+        for(std::future<void>& ft : futures) {
+            while(ft.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                pool_.run_pending_task();
+            }
+        }
+        // CRITICAL: rethrow only once all tasks are done, they all refer to locals of run()
+        for(std::future<void>& ft : futures) {
+            ft.get();
+        }
+    }
+
+    // one scan task, spills[p] receives the groups of partition p
+    void scan(const std::pair<KT, VT>* rows, size_t row_num, std::atomic<size_t>& cursor,
+        std::vector<std::vector<Partial>>& spills) const {
+        FlatTable table(LOCAL_CAPACITY);
+        auto spill = [this, &spills](Partial&& partial) {
+            spills[partitionOf(partial.hash_)].push_back(std::move(partial));
+        };
+        size_t begin;
+        while((begin = cursor.fetch_add(CHUNK_ROWS, std::memory_order_relaxed)) < row_num) {
+            size_t end = std::min(begin + CHUNK_ROWS, row_num);
+            for(size_t i = begin; i < end; ++i) {
+                const auto& [key, value] = rows[i];
+                agg_.update(table.find_or_insert(hashOf(key), key, agg_), value);
+                if(table.size() * 2 >= table.capacity()) {
+                    table.drain(spill);
+                }
+            }
+        }
+        table.drain(spill);
+    }
+
+    // merge partition p of every scan task into out
+    void merge(size_t p, std::vector<std::vector<std::vector<Partial>>>& spills,
+        std::vector<std::pair<KT, State>>& out) const {
+        size_t total = 0;
+        for(const auto& task_spills : spills) {
+            total += task_spills[p].size();
+        }
+        if(total == 0) {
+            return;
+        }
+        FlatTable table(roundUpPowerOfTwo(total * 2));
+        for(auto& task_spills : spills) {
+            for(Partial& partial : task_spills[p]) {
+                agg_.merge(table.find_or_insert(partial.hash_, partial.key_, agg_), partial.state_);
+            }
+            // done with it, give the memory back early
+            std::vector<Partial>().swap(task_spills[p]);
+        }
+        out.reserve(table.size());
+        table.drain([&out](Partial&& partial) {
+            out.emplace_back(std::move(partial.key_), std::move(partial.state_));
+        });
+    }
+
+public:
+    /**
+     * task_num of 0 means one scan task per hardware thread (the size of a ThreadPoolDemo01). 2^partition_bits
+     * partitions are merged in parallel, more of them give smaller merge tables at the price of more spill buffers.
+     */
+    explicit ParallelGroupBy(ThreadPoolDemo01& pool, Agg agg = Agg(), size_t partition_bits = 6,
+        size_t task_num = 0, size_t chunk_rows = 1 << 14, const Hash& hasher = Hash()):
+    pool_(pool), agg_(std::move(agg)), hasher_(hasher), PARTITION_BITS(std::min<size_t>(partition_bits, 16)),
+    TASK_NUM(task_num ? task_num : std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+    CHUNK_ROWS(std::max<size_t>(chunk_rows, 1)) {}
+
+    std::vector<std::pair<KT, State>> run(const std::pair<KT, VT>* rows, size_t row_num) {
+        const size_t PARTITION_NUM = size_t(1) << PARTITION_BITS;
+        // spills[task][partition]
+        std::vector<std::vector<std::vector<Partial>>> spills(TASK_NUM,
+            std::vector<std::vector<Partial>>(PARTITION_NUM));
+        std::atomic<size_t> cursor(0);
+        std::vector<std::future<void>> futures;
+        futures.reserve(std::max(TASK_NUM, PARTITION_NUM));
+        for(size_t t = 0; t < TASK_NUM; ++t) {
+            futures.push_back(pool_.submit([this, rows, row_num, &cursor, &spills, t]() {
+                scan(rows, row_num, cursor, spills[t]);
+            }));
+        }
+        helpUntilReady(futures);
+        futures.clear();
+
+        std::vector<std::vector<std::pair<KT, State>>> merged(PARTITION_NUM);
+        for(size_t p = 0; p < PARTITION_NUM; ++p) {
+            futures.push_back(pool_.submit([this, p, &spills, &merged]() {
+                merge(p, spills, merged[p]);
+            }));
+        }
+        helpUntilReady(futures);
+
+        size_t total = 0;
+        for(const auto& part : merged) {
+            total += part.size();
+        }
+        std::vector<std::pair<KT, State>> ret;
+        ret.reserve(total);
+        for(auto& part : merged) {
+            std::move(part.begin(), part.end(), std::back_inserter(ret));
+        }
+        return ret;
+    }
+
+    std::vector<std::pair<KT, State>> run(const std::vector<std::pair<KT, VT>>& rows) {
+        return run(rows.data(), rows.size());
+    }
+};
+
+#endif //PARALLEL_GROUP_BY_H
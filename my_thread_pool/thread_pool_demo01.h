@@ -4,10 +4,18 @@
 
 #ifndef THREAD_POOL_DEMO01_H
 #define THREAD_POOL_DEMO01_H
-#include "../sync_container_with_lock/my_sync_queue/my_sync_queue.h"
+#include "../sync_container_lock_free/my_work_stealing_deque/my_chase_lev_deque.h"
 #include "../my_utility/my_defer.h"
+#include "../my_utility/my_cpu_topology.h"
+#include "../my_utility/my_pool_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <thread>
 #include <vector>
-#include <deque>
 #include <mutex>
 
 class TaskWrapper {
@@ -28,6 +36,9 @@ class TaskWrapper {
     };
     std::unique_ptr<TaskWrapperInterface> func_;
 public:
+    // the callable as one owning raw pointer, for containers that only hold trivially copyable values
+    using Raw = TaskWrapperInterface*;
+
     template <typename Callable>
     TaskWrapper(Callable&& func): func_(std::make_unique<TaskWrapperImpl<std::decay_t<Callable>>>(std::forward<Callable>(func))) {}
     void operator()() const {
@@ -43,48 +54,63 @@ public:
         func_ = std::move(wrapper.func_);
         return *this;
     }
-};
 
-template <typename T>
-class NaiveStealingQueue {
-    std::deque<std::shared_ptr<T>> queue_;
-    std::mutex mtx_;
-public:
-    NaiveStealingQueue() = default;
-    ~NaiveStealingQueue() = default;
-    NaiveStealingQueue(const NaiveStealingQueue&) = delete;
-    NaiveStealingQueue& operator=(const NaiveStealingQueue&) = delete;
-    NaiveStealingQueue(NaiveStealingQueue&&) = delete;
-    NaiveStealingQueue& operator=(NaiveStealingQueue&&) = delete;
-
-    template <typename U>
-    void push(U&& ele) {
-        std::lock_guard<std::mutex> guard(mtx_);
-        queue_.emplace_front(std::make_shared<T>(std::forward<U>(ele)));
+    // the wrapper is empty afterwards, whoever holds the pointer owns the callable until adopt()
+    Raw release() {
+        return func_.release();
     }
-
-    std::shared_ptr<T> tryPop() {
-        std::lock_guard<std::mutex> guard(mtx_);
-        if(queue_.empty()) {
-            return nullptr;
-        }
-        std::shared_ptr<T> ret = queue_.front();
-        queue_.pop_front();
-        return ret;
-    }
-
-    std::shared_ptr<T> trySteal() {
-        std::lock_guard<std::mutex> guard(mtx_);
-        if(queue_.empty()) {
-            return nullptr;
-        }
-        std::shared_ptr<T> ret = queue_.back();
-        queue_.pop_back();
+    static TaskWrapper adopt(Raw raw) {
+        TaskWrapper ret;
+        ret.func_.reset(raw);
         return ret;
     }
+private:
+    TaskWrapper() = default;
 };
 
 class ThreadPoolDemo01 {
+    /**
+     * What outside threads submit, as owning raw pointers in a ring under a mutex. The ring doubles when full and never
+     * shrinks, so once it is big enough a submit allocates nothing besides the TaskWrapper itself, no list node and no
+     * shared_ptr per task. size_ is only read without the lock as a hint, so an idle worker can skip the lock.
+     */
+    class Injector {
+        std::mutex mtx_;
+        std::vector<TaskWrapper::Raw> ring_ = std::vector<TaskWrapper::Raw>(64);
+        size_t head_ = 0;
+        std::atomic<size_t> size_{0};
+    public:
+        void push(TaskWrapper::Raw raw) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            const size_t size = size_.load(std::memory_order_relaxed);
+            if(size == ring_.size()) {
+                std::vector<TaskWrapper::Raw> bigger(ring_.size() * 2);
+                for(size_t i = 0; i < size; ++i) {
+                    bigger[i] = ring_[(head_ + i) & (ring_.size() - 1)];
+                }
+                ring_.swap(bigger);
+                head_ = 0;
+            }
+            ring_[(head_ + size) & (ring_.size() - 1)] = raw;
+            size_.store(size + 1, std::memory_order_relaxed);
+        }
+
+        std::optional<TaskWrapper::Raw> tryPop() {
+            if(size_.load(std::memory_order_relaxed) == 0) {
+                return std::nullopt;
+            }
+            std::lock_guard<std::mutex> lock(mtx_);
+            const size_t size = size_.load(std::memory_order_relaxed);
+            if(size == 0) {
+                return std::nullopt;
+            }
+            TaskWrapper::Raw ret = ring_[head_];
+            head_ = (head_ + 1) & (ring_.size() - 1);
+            size_.store(size - 1, std::memory_order_relaxed);
+            return ret;
+        }
+    };
+
     struct ThreadGuardian {
     private:
         std::vector<std::thread>& threads_;
@@ -99,83 +125,161 @@ class ThreadPoolDemo01 {
 
         }
     };
-    // MySyncQueue<TaskWrapper> sync_queue_;
     std::atomic<bool> stop_;
     const int THREAD_NUM_;
+    // must declare before thd_guardian_, the workers use the queues until they are joined. all_queues_[i] belongs to
+    // worker i, tasks submitted by any other thread go to injected_
+    std::vector<std::unique_ptr<MyChaseLevDeque<TaskWrapper::Raw>>> all_queues_;
+    Injector injected_;
+    // by worker, written only by that worker. Same as the queues, must outlive the threads
+    std::unique_ptr<MyWorkerCounters[]> counters_;
+    const std::chrono::steady_clock::time_point started_;
     std::vector<std::thread> threads;
     // must declare after threads
     ThreadGuardian thd_guardian_;
-    std::vector<std::unique_ptr<NaiveStealingQueue<TaskWrapper>>> all_queues_;
+    // the CPU of each worker, -1 where it is not pinned
+    std::vector<int> cpu_of_thread_;
 
-    static thread_local NaiveStealingQueue<TaskWrapper>* per_thread_queue_;
+    // the pool whose worker this thread is, and its index there
+    static thread_local const ThreadPoolDemo01* owner_pool_;
     static thread_local int thread_id;
 
     void worker_thread(int id) {
+        owner_pool_ = this;
         thread_id = id;
-        per_thread_queue_ = all_queues_[id].get();
         while(!stop_) {
-            // TODO: add conditional variable to naive stealing queue to avoid busy waiting
+            // TODO: add conditional variable to avoid busy waiting
             run_pending_task();
         }
     }
 
-    // round robin
-    std::atomic<size_t> responsible_thread_id_ = 0;
+    // this thread's index if it is one of our workers, -1 otherwise
+    int local_id() const {
+        return owner_pool_ == this ? thread_id : -1;
+    }
 
-    size_t get_resposible_thread_id() {
-        size_t current = responsible_thread_id_.load(std::memory_order_relaxed);
-        while(!responsible_thread_id_.compare_exchange_weak(current, (current + 1) % THREAD_NUM_, std::memory_order_relaxed));
-        return current;
+    void run(TaskWrapper::Raw raw) {
+        TaskWrapper task = TaskWrapper::adopt(raw);
+        task();
     }
 public:
-    ThreadPoolDemo01(): THREAD_NUM_(std::thread::hardware_concurrency()), thd_guardian_(threads) {
+    explicit ThreadPoolDemo01(const MyAffinityPolicy& affinity = MyAffinityPolicy()):
+    THREAD_NUM_(std::thread::hardware_concurrency()), counters_(std::make_unique<MyWorkerCounters[]>(THREAD_NUM_)),
+    started_(std::chrono::steady_clock::now()), thd_guardian_(threads) {
         all_queues_.reserve(THREAD_NUM_);
         for(int i=0; i<THREAD_NUM_; ++i) {
-            all_queues_.push_back(std::make_unique<NaiveStealingQueue<TaskWrapper>>());
+            all_queues_.push_back(std::make_unique<MyChaseLevDeque<TaskWrapper::Raw>>());
         }
         threads.reserve(THREAD_NUM_);
+        cpu_of_thread_ = affinity.kind_ == MyAffinityPolicy::NONE ?
+            std::vector<int>(THREAD_NUM_, -1) : MyCpuTopology().place(affinity, THREAD_NUM_);
         for(int i=0; i<THREAD_NUM_; ++i) {
             threads.emplace_back(&ThreadPoolDemo01::worker_thread, this, i);
+            if(cpu_of_thread_[i] >= 0 && !MyCpuTopology::pin(threads[i].native_handle(), cpu_of_thread_[i])) {
+                cpu_of_thread_[i] = -1;
+            }
         }
     }
     ~ThreadPoolDemo01() {
-        // sync_queue_.close();
         stop_.store(true);
+        for(std::thread& thd : threads) {
+            if(thd.joinable()) {
+                thd.join();
+            }
+        }
+        // the deques and the injector hold raw pointers, free what nobody ran. Their futures report broken_promise
+        for(auto& queue : all_queues_) {
+            while(std::optional<TaskWrapper::Raw> raw = queue->pop()) {
+                TaskWrapper::adopt(*raw);
+            }
+        }
+        while(std::optional<TaskWrapper::Raw> raw = injected_.tryPop()) {
+            TaskWrapper::adopt(*raw);
+        }
     }
 
     template <typename Callable>
     std::future<typename std::result_of<Callable()>::type> submit(Callable&& clb) {
         using ret_type = typename std::result_of<Callable()>::type;
-        std::packaged_task<ret_type()> pkgd_tsk(std::forward<Callable>(clb));
+        // the timing rides along inside the task, the deques only hold one pointer. CRITICAL: it is recorded before
+        // the packaged_task publishes the result, whoever is done waiting on the future finds the task in stats()
+        std::packaged_task<ret_type()> pkgd_tsk([this, func = std::forward<Callable>(clb),
+            enqueued = std::chrono::steady_clock::now()]() mutable -> ret_type {
+            int id = local_id();
+            if(id < 0) {
+                return func();
+            }
+            auto start = std::chrono::steady_clock::now();
+            Defer record([this, id, start, enqueued]() {
+                counters_[id].task_done(start - enqueued, std::chrono::steady_clock::now() - start);
+            });
+            return func();
+        });
         std::future<ret_type> ft = pkgd_tsk.get_future();
         // since a packaged_task stores exception internally, if we guarantee to call it only once, it's unlikely to throw
         // packaged_task is not copyable but moveable
         TaskWrapper task(std::move(pkgd_tsk));
-        size_t id = get_resposible_thread_id();
-        all_queues_[id]->push(std::move(task));
+        int id = local_id();
+        if(id >= 0) {
+            // a task spawned by a task stays with its worker, LIFO, while it is hot in the cache
+            all_queues_[id]->push(task.release());
+        } else {
+            injected_.push(task.release());
+        }
         return ft;
     }
 
+    const std::vector<int>& cpu_mapping() const {
+        return cpu_of_thread_;
+    }
+
+    /**
+     * One entry per worker: tasks run, busy time, steals, wait and run time histograms. A worker spins while it has
+     * nothing to do, so idle is simply its lifetime minus busy. Tasks that outside threads run through
+     * run_pending_task() are not counted.
+     */
+    MyPoolStats stats() const {
+        MyPoolStats ret;
+        auto alive = std::chrono::steady_clock::now() - started_;
+        for(int i = 0; i < THREAD_NUM_; ++i) {
+            MyWorkerStats worker = counters_[i].snapshot();
+            worker.idle_ = std::max(std::chrono::nanoseconds(alive) - worker.busy_, std::chrono::nanoseconds(0));
+            ret.workers_.push_back(worker);
+        }
+        return ret;
+    }
+
     void run_pending_task() {
-        std::shared_ptr<TaskWrapper> task;
-        if(per_thread_queue_) {
+        const int id = local_id();
+        if(id >= 0) {
             // try to get a task from its own queue
-            if((task = per_thread_queue_->tryPop())) {
-                (*task)();
+            if(std::optional<TaskWrapper::Raw> raw = all_queues_[id]->pop()) {
+                run(*raw);
                 return;
             }
         }
+        // then what outside threads submitted
+        if(std::optional<TaskWrapper::Raw> raw = injected_.tryPop()) {
+            run(*raw);
+            return;
+        }
         // steal one
-        int begin_idx = (thread_id + 1) % THREAD_NUM_;
-        int end_idx = thread_id;
-        if(thread_id == -1) {
-            // an outside thread
+        int begin_idx = (id + 1) % THREAD_NUM_;
+        int steal_num = THREAD_NUM_ - 1;
+        if(id == -1) {
+            // an outside thread, every queue is someone else's
             begin_idx = 0;
-            end_idx = THREAD_NUM_;
+            steal_num = THREAD_NUM_;
         }
-        for(int offset = begin_idx; offset != end_idx; offset = (offset + 1) % THREAD_NUM_) {
-            if((task = all_queues_[offset]->tryPop())) {
-                (*task)();
+        // count the visits, offset wraps around and would never reach THREAD_NUM_
+        for(int i = 0; i < steal_num; ++i) {
+            int offset = (begin_idx + i) % THREAD_NUM_;
+            std::optional<TaskWrapper::Raw> raw = all_queues_[offset]->steal();
+            if(id >= 0) {
+                counters_[id].steal_attempted(raw.has_value());
+            }
+            if(raw) {
+                run(*raw);
                 return;
             }
         }
@@ -185,6 +289,6 @@ public:
 };
 
 // Provide definitions for static thread_local members
-thread_local NaiveStealingQueue<TaskWrapper>* ThreadPoolDemo01::per_thread_queue_ = nullptr;
+thread_local const ThreadPoolDemo01* ThreadPoolDemo01::owner_pool_ = nullptr;
 thread_local int ThreadPoolDemo01::thread_id = -1;
 #endif //THREAD_POOL_DEMO01_H
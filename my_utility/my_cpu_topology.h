@@ -0,0 +1,194 @@
+//
+// Created by Charles Green on 11/1/25.
+//
+
+#ifndef MY_CPU_TOPOLOGY_H
+#define MY_CPU_TOPOLOGY_H
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Where to run the workers of a pool:
+ *  - NONE leaves it to the kernel;
+ *  - COMPACT packs them, hyper-threads of one core first, then the next core of the same socket, sockets last. Good
+ *    when the workers share data;
+ *  - SCATTER spreads them, one per socket in turn, then one per core, hyper-thread siblings only once every core has
+ *    a worker. Good for bandwidth bound work;
+ *  - EXPLICIT takes the CPU ids in cpus_, worker i gets cpus_[i % size].
+ * CPUs this process may not run on (cpuset, taskset) are left out, so a policy works on any box. With fewer CPUs than
+ * workers the placement wraps around.
+ */
+struct MyAffinityPolicy {
+    enum Kind { NONE, COMPACT, SCATTER, EXPLICIT };
+    Kind kind_ = NONE;
+    std::vector<int> cpus_;
+
+    static MyAffinityPolicy compact() {
+        return {COMPACT, {}};
+    }
+    static MyAffinityPolicy scatter() {
+        return {SCATTER, {}};
+    }
+    static MyAffinityPolicy explicit_cpus(std::vector<int> cpus) {
+        return {EXPLICIT, std::move(cpus)};
+    }
+};
+
+/**
+ * The CPUs of this machine as /sys/devices/system/cpu describes them, restricted to the ones sched_getaffinity()
+ * allows. Without sysfs every allowed CPU counts as its own core on socket 0.
+ */
+class MyCpuTopology {
+public:
+    struct Cpu {
+        int cpu_;
+        int core_;
+        int package_;
+    };
+
+private:
+    std::vector<Cpu> cpus_;
+
+    // "0-3,8,10-11" as in /sys/devices/system/cpu/online
+    static std::vector<int> parseList(const std::string& list) {
+        std::vector<int> ret;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            if(range.empty()) {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu) {
+                ret.push_back(cpu);
+            }
+        }
+        return ret;
+    }
+
+    // -1 if the file is missing
+    static int readInt(const std::string& path) {
+        std::ifstream in(path);
+        int value = -1;
+        if(!(in >> value)) {
+            return -1;
+        }
+        return value;
+    }
+
+public:
+    MyCpuTopology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool restricted = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        std::vector<int> online;
+        std::ifstream in("/sys/devices/system/cpu/online");
+        std::string list;
+        if(std::getline(in, list)) {
+            online = parseList(list);
+        }
+        if(online.empty()) {
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if(restricted && CPU_ISSET(cpu, &allowed)) {
+                    online.push_back(cpu);
+                }
+            }
+        }
+        for(int cpu : online) {
+            if(cpu >= CPU_SETSIZE || (restricted && !CPU_ISSET(cpu, &allowed))) {
+                continue;
+            }
+            std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            int core = readInt(dir + "core_id");
+            int package = readInt(dir + "physical_package_id");
+            cpus_.push_back({cpu, core < 0 ? cpu : core, package < 0 ? 0 : package});
+        }
+    }
+
+    // a made-up machine, to see what a policy does on hardware we do not have
+    explicit MyCpuTopology(std::vector<Cpu> cpus): cpus_(std::move(cpus)) {}
+
+    const std::vector<Cpu>& cpus() const {
+        return cpus_;
+    }
+
+    // the CPU of each of worker_num workers under policy, -1 where the worker is not pinned
+    std::vector<int> place(const MyAffinityPolicy& policy, size_t worker_num) const {
+        std::vector<int> order;
+        if(policy.kind_ == MyAffinityPolicy::EXPLICIT) {
+            for(int cpu : policy.cpus_) {
+                bool known = std::any_of(cpus_.begin(), cpus_.end(), [cpu](const Cpu& c) { return c.cpu_ == cpu; });
+                if(known) {
+                    order.push_back(cpu);
+                }
+            }
+        } else if(policy.kind_ == MyAffinityPolicy::COMPACT) {
+            std::vector<Cpu> sorted = cpus_;
+            std::sort(sorted.begin(), sorted.end(), [](const Cpu& a, const Cpu& b) {
+                return std::tie(a.package_, a.core_, a.cpu_) < std::tie(b.package_, b.core_, b.cpu_);
+            });
+            for(const Cpu& c : sorted) {
+                order.push_back(c.cpu_);
+            }
+        } else if(policy.kind_ == MyAffinityPolicy::SCATTER) {
+            // package -> core -> hyper-threads
+            std::map<int, std::map<int, std::vector<int>>> tree;
+            for(const Cpu& c : cpus_) {
+                tree[c.package_][c.core_].push_back(c.cpu_);
+            }
+            std::vector<std::vector<std::vector<int>>> packages;
+            for(auto& [package, cores] : tree) {
+                packages.emplace_back();
+                for(auto& [core, threads] : cores) {
+                    packages.back().push_back(threads);
+                }
+            }
+            size_t max_cores = 0;
+            size_t max_threads = 0;
+            for(const auto& cores : packages) {
+                max_cores = std::max(max_cores, cores.size());
+                for(const auto& threads : cores) {
+                    max_threads = std::max(max_threads, threads.size());
+                }
+            }
+            for(size_t t = 0; t < max_threads; ++t) {
+                for(size_t c = 0; c < max_cores; ++c) {
+                    for(const auto& cores : packages) {
+                        if(c < cores.size() && t < cores[c].size()) {
+                            order.push_back(cores[c][t]);
+                        }
+                    }
+                }
+            }
+        }
+        std::vector<int> ret(worker_num, -1);
+        if(!order.empty()) {
+            for(size_t i = 0; i < worker_num; ++i) {
+                ret[i] = order[i % order.size()];
+            }
+        }
+        return ret;
+    }
+
+    // false if the kernel refuses, the thread then keeps running wherever it was allowed to
+    static bool pin(pthread_t thread, int cpu) {
+        if(cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+};
+
+#endif //MY_CPU_TOPOLOGY_H
@@ -0,0 +1,201 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_EPOCH_RECLAIMER_H
+#define MY_EPOCH_RECLAIMER_H
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * Epoch based reclamation, shared by every container in the process.
+ *
+ * A reader wraps its traversal in an EpochReclaimer::Guard, which announces the global epoch in a per-thread slot.
+ * A writer unlinks a node first and then calls retire(node): the node is tagged with the current epoch and kept in a
+ * buffer of the retiring thread. Once the buffer is big enough the thread calls collect(), which moves the global
+ * epoch forward and deletes the nodes of the buffer whose tag is below every announced epoch, i.e. every reader that
+ * could still hold a pointer to them has left its guard.
+ *
+ * retire() touches no shared cache line for writing, no lock and no read-modify-write: one fence and a push_back.
+ * The nodes a thread leaves behind when it exits are handed over to whoever collects next.
+ *
+ * Unlike hazard pointers, the reader never has to publish-and-validate each pointer it follows, so a traversal is a
+ * plain sequence of loads.
+ */
+class EpochReclaimer {
+    static constexpr int SLOT_NUM = 1024;
+    static constexpr size_t COLLECT_THRESHOLD = 128;
+    struct alignas(64) EpochSlot {
+        // 0 means the owner thread is not reading
+        std::atomic<uint64_t> epoch_;
+        std::atomic<bool> occupied_;
+        EpochSlot(): epoch_(0), occupied_(false) {}
+        EpochSlot(const EpochSlot&) = delete;
+        EpochSlot& operator=(const EpochSlot&) = delete;
+    };
+    struct RetiredNode {
+        void* ptr_;
+        void (*deletor_)(void*);
+        uint64_t epoch_;
+    };
+    // the slot and the nodes still waiting are given back when the thread exits
+    struct ThreadSlot {
+        EpochSlot* slot_ = nullptr;
+        int depth_ = 0;
+        std::vector<RetiredNode> retired_;
+        // collect once retired_ grows to this size, so nodes pinned by a long reader are not rescanned on every retire
+        size_t collect_at_ = COLLECT_THRESHOLD;
+        ~ThreadSlot() {
+            if(slot_) {
+                slot_->epoch_.store(0);
+                slot_->occupied_.store(false);
+            }
+            if(!retired_.empty()) {
+                EpochReclaimer::instance().adopt(retired_);
+            }
+        }
+    };
+    template <typename T>
+    static void delete_as(void* ptr) {
+        delete static_cast<T*>(ptr);
+    }
+
+    EpochSlot slots_[SLOT_NUM];
+    std::atomic<uint64_t> global_epoch_;
+    // nodes of exited threads, rare, so a mutex is fine
+    std::mutex orphans_mtx_;
+    std::vector<RetiredNode> orphans_;
+    std::atomic<bool> has_orphans_;
+
+    EpochReclaimer(): global_epoch_(1), has_orphans_(false) {}
+
+    ThreadSlot& thread_slot() {
+        thread_local ThreadSlot ts;
+        if(!ts.slot_) {
+            for(int i=0;i<SLOT_NUM;++i) {
+                bool expect = false;
+                if(slots_[i].occupied_.compare_exchange_strong(expect, true)) {
+                    ts.slot_ = &slots_[i];
+                    return ts;
+                }
+            }
+            throw std::runtime_error("epoch reclaimer is out of slots");
+        }
+        return ts;
+    }
+
+    uint64_t min_active_epoch() const {
+        uint64_t min_epoch = global_epoch_.load();
+        for(int i=0;i<SLOT_NUM;++i) {
+            uint64_t e = slots_[i].epoch_.load();
+            if(e != 0 && e < min_epoch) {
+                min_epoch = e;
+            }
+        }
+        return min_epoch;
+    }
+
+    // deletes the nodes no reader can see anymore, keeps the others in nodes
+    static void free_older_than(std::vector<RetiredNode>& nodes, uint64_t safe_epoch) {
+        auto keep = std::partition(nodes.begin(), nodes.end(), [safe_epoch](const RetiredNode& node) {
+            return node.epoch_ >= safe_epoch;
+        });
+        std::vector<RetiredNode> to_delete(keep, nodes.end());
+        nodes.erase(keep, nodes.end());
+        // a destructor may retire again, so run them once nodes is consistent
+        for(RetiredNode& node : to_delete) {
+            node.deletor_(node.ptr_);
+        }
+    }
+
+    void adopt(std::vector<RetiredNode>& nodes) {
+        std::lock_guard<std::mutex> grd(orphans_mtx_);
+        orphans_.insert(orphans_.end(), nodes.begin(), nodes.end());
+        nodes.clear();
+        has_orphans_.store(true, std::memory_order_release);
+    }
+public:
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+    ~EpochReclaimer() {
+        // nobody can be reading at static destruction time
+        for(RetiredNode& node : orphans_) {
+            node.deletor_(node.ptr_);
+        }
+    }
+
+    static EpochReclaimer& instance() {
+        static EpochReclaimer reclaimer;
+        return reclaimer;
+    }
+
+    // reentrant: only the outermost guard announces an epoch
+    struct Guard {
+        EpochReclaimer& reclaimer_;
+        Guard(): reclaimer_(EpochReclaimer::instance()) {
+            reclaimer_.enter();
+        }
+        ~Guard() {
+            reclaimer_.leave();
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    void enter() {
+        ThreadSlot& ts = thread_slot();
+        if(ts.depth_++ == 0) {
+            ts.slot_->epoch_.store(global_epoch_.load());
+            // the announcement must be visible before we load any shared pointer
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void leave() {
+        ThreadSlot& ts = thread_slot();
+        if(--ts.depth_ == 0) {
+            ts.slot_->epoch_.store(0, std::memory_order_release);
+        }
+    }
+
+    // ptr must already be unreachable for readers that enter from now on
+    template <typename T>
+    void retire(T* ptr) {
+        ThreadSlot& ts = thread_slot();
+        // CRITICAL: the unlink must be visible before we read the epoch. A reader that entered with an older epoch is
+        // then waited for, and one that read this epoch or a later one went through its fence after ours and cannot
+        // find ptr anymore. A seq_cst load alone may pass the unlink store still sitting in the store buffer
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        ts.retired_.push_back(RetiredNode{ptr, &delete_as<T>, global_epoch_.load()});
+        if(ts.retired_.size() >= ts.collect_at_) {
+            collect();
+        }
+    }
+
+    // frees what the calling thread retired and no reader can see anymore, plus the nodes of exited threads
+    void collect() {
+        ThreadSlot& ts = thread_slot();
+        // the only write to global_epoch_: readers entering from now on cannot see anything retired so far
+        global_epoch_.fetch_add(1);
+        uint64_t safe_epoch = min_active_epoch();
+        free_older_than(ts.retired_, safe_epoch);
+        ts.collect_at_ = ts.retired_.size() + COLLECT_THRESHOLD;
+        if(has_orphans_.load(std::memory_order_acquire)) {
+            std::vector<RetiredNode> orphans;
+            {
+                std::lock_guard<std::mutex> grd(orphans_mtx_);
+                orphans.swap(orphans_);
+                has_orphans_.store(false, std::memory_order_relaxed);
+            }
+            free_older_than(orphans, safe_epoch);
+            if(!orphans.empty()) {
+                adopt(orphans);
+            }
+        }
+    }
+};
+
+#endif //MY_EPOCH_RECLAIMER_H
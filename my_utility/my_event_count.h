@@ -0,0 +1,103 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_EVENT_COUNT_H
+#define MY_EVENT_COUNT_H
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A condition variable that costs nothing to signal when nobody sleeps on it.
+ *
+ * A waiter registers itself first, then re-checks its condition, then sleeps:
+ * ```
+ * while(true) {
+ *     if(condition()) break;
+ *     uint64_t key = ec.prepare_wait();
+ *     if(condition()) { ec.cancel_wait(); break; }
+ *     ec.wait(key);
+ * }
+ * ```
+ * A notifier makes the condition true first, then calls notify_one/notify_all. Both sides use seq_cst, so either the
+ * waiter sees the new condition in its re-check, or the notifier sees the registered waiter. The mutex is only touched
+ * when somebody is actually sleeping.
+ */
+class EventCount {
+    std::atomic<uint64_t> epoch_;
+    std::atomic<int> waiters_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+
+    void signal(bool all) {
+        epoch_.fetch_add(1);
+        {
+            // the waiter checks epoch_ under the lock, so it is either before its check or already waiting
+            std::lock_guard<std::mutex> grd(mtx_);
+        }
+        if(all) {
+            cv_.notify_all();
+        } else {
+            cv_.notify_one();
+        }
+    }
+public:
+    EventCount(): epoch_(0), waiters_(0) {}
+    EventCount(const EventCount&) = delete;
+    EventCount& operator=(const EventCount&) = delete;
+
+    uint64_t prepare_wait() {
+        waiters_.fetch_add(1);
+        return epoch_.load();
+    }
+
+    void cancel_wait() {
+        waiters_.fetch_sub(1);
+    }
+
+    void wait(uint64_t key) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this, key]() {
+                return epoch_.load() != key;
+            });
+        }
+        waiters_.fetch_sub(1);
+    }
+
+    // false on timeout
+    template <typename Clock, typename Duration>
+    bool wait_until(uint64_t key, const std::chrono::time_point<Clock, Duration>& deadline) {
+        bool signaled;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            signaled = cv_.wait_until(lock, deadline, [this, key]() {
+                return epoch_.load() != key;
+            });
+        }
+        waiters_.fetch_sub(1);
+        return signaled;
+    }
+
+    void notify_one() {
+        if(waiters_.load() == 0) {
+            return;
+        }
+        signal(false);
+    }
+
+    void notify_all() {
+        if(waiters_.load() == 0) {
+            return;
+        }
+        signal(true);
+    }
+
+    int waiters() const {
+        return waiters_.load(std::memory_order_relaxed);
+    }
+};
+
+#endif //MY_EVENT_COUNT_H
@@ -0,0 +1,157 @@
+//
+// Created by Charles Green on 11/6/25.
+//
+
+#ifndef MY_POOL_STATS_H
+#define MY_POOL_STATS_H
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Durations in power of two buckets, bucket b counts [2^b, 2^(b+1)) nanoseconds (bucket 0 also 0), the last one
+ * everything from 2^(BUCKET_NUM-1) ns (about 9 minutes) up. Coarse, but adding one is a bit scan and an increment.
+ */
+struct MyDurationHistogram {
+    static constexpr int BUCKET_NUM = 40;
+    uint64_t buckets_[BUCKET_NUM] = {};
+
+    static int bucketOf(std::chrono::nanoseconds duration) {
+        uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+        int b = ns == 0 ? 0 : std::bit_width(ns) - 1;
+        return b < BUCKET_NUM ? b : BUCKET_NUM - 1;
+    }
+
+    uint64_t count() const {
+        uint64_t ret = 0;
+        for(uint64_t n : buckets_) {
+            ret += n;
+        }
+        return ret;
+    }
+
+    // the upper end of the bucket the q-th quantile falls into, 0 when empty
+    std::chrono::nanoseconds percentile(double q) const {
+        uint64_t total = count();
+        if(total == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1));
+        uint64_t seen = 0;
+        for(int b = 0; b < BUCKET_NUM; ++b) {
+            seen += buckets_[b];
+            if(seen > rank) {
+                return std::chrono::nanoseconds(int64_t(2) << b);
+            }
+        }
+        return std::chrono::nanoseconds(int64_t(2) << (BUCKET_NUM - 1));
+    }
+
+    void merge(const MyDurationHistogram& other) {
+        for(int b = 0; b < BUCKET_NUM; ++b) {
+            buckets_[b] += other.buckets_[b];
+        }
+    }
+};
+
+// what one worker did so far, or the sum over several
+struct MyWorkerStats {
+    uint64_t tasks_ = 0;
+    std::chrono::nanoseconds busy_{0};
+    std::chrono::nanoseconds idle_{0};
+    // other workers' queues looked into, and the tasks found there. Only pools that steal fill these
+    uint64_t steal_attempts_ = 0;
+    uint64_t steals_ = 0;
+    // from the submit to the start of the task, and from its start to its end
+    MyDurationHistogram wait_;
+    MyDurationHistogram run_;
+
+    void merge(const MyWorkerStats& other) {
+        tasks_ += other.tasks_;
+        busy_ += other.busy_;
+        idle_ += other.idle_;
+        steal_attempts_ += other.steal_attempts_;
+        steals_ += other.steals_;
+        wait_.merge(other.wait_);
+        run_.merge(other.run_);
+    }
+
+    // share of the time spent running tasks, near 1 means saturated
+    double utilization() const {
+        auto total = busy_ + idle_;
+        return total.count() ? static_cast<double>(busy_.count()) / static_cast<double>(total.count()) : 0.0;
+    }
+};
+
+// a stats() snapshot of a pool, one entry per worker
+struct MyPoolStats {
+    std::vector<MyWorkerStats> workers_;
+
+    MyWorkerStats total() const {
+        MyWorkerStats ret;
+        for(const MyWorkerStats& worker : workers_) {
+            ret.merge(worker);
+        }
+        return ret;
+    }
+};
+
+/**
+ * The live counters of one worker. Only that worker writes them, so an update is a relaxed load and store to a cache
+ * line of its own, no lock prefix and no line bouncing between workers. Anybody may read at any time, a reader
+ * just sees a slightly stale value.
+ */
+class alignas(64) MyWorkerCounters {
+    std::atomic<uint64_t> tasks_{0};
+    std::atomic<uint64_t> busy_ns_{0};
+    std::atomic<uint64_t> idle_ns_{0};
+    std::atomic<uint64_t> steal_attempts_{0};
+    std::atomic<uint64_t> steals_{0};
+    std::atomic<uint64_t> wait_[MyDurationHistogram::BUCKET_NUM] = {};
+    std::atomic<uint64_t> run_[MyDurationHistogram::BUCKET_NUM] = {};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static uint64_t nonNegative(std::chrono::nanoseconds duration) {
+        return duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+    }
+
+public:
+    void task_done(std::chrono::nanoseconds wait, std::chrono::nanoseconds run) {
+        bump(tasks_);
+        bump(busy_ns_, nonNegative(run));
+        bump(wait_[MyDurationHistogram::bucketOf(wait)]);
+        bump(run_[MyDurationHistogram::bucketOf(run)]);
+    }
+
+    void idled(std::chrono::nanoseconds idle) {
+        bump(idle_ns_, nonNegative(idle));
+    }
+
+    void steal_attempted(bool succeeded) {
+        bump(steal_attempts_);
+        if(succeeded) {
+            bump(steals_);
+        }
+    }
+
+    MyWorkerStats snapshot() const {
+        MyWorkerStats ret;
+        ret.tasks_ = tasks_.load(std::memory_order_relaxed);
+        ret.busy_ = std::chrono::nanoseconds(busy_ns_.load(std::memory_order_relaxed));
+        ret.idle_ = std::chrono::nanoseconds(idle_ns_.load(std::memory_order_relaxed));
+        ret.steal_attempts_ = steal_attempts_.load(std::memory_order_relaxed);
+        ret.steals_ = steals_.load(std::memory_order_relaxed);
+        for(int b = 0; b < MyDurationHistogram::BUCKET_NUM; ++b) {
+            ret.wait_.buckets_[b] = wait_[b].load(std::memory_order_relaxed);
+            ret.run_.buckets_[b] = run_[b].load(std::memory_order_relaxed);
+        }
+        return ret;
+    }
+};
+
+#endif //MY_POOL_STATS_H
@@ -0,0 +1,128 @@
+//
+// Created by Charles Green on 10/30/25.
+//
+
+#ifndef MY_TASK_H
+#define MY_TASK_H
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A move-only void() callable with small buffer optimization, what std::function<void()> would be without the copy
+ * requirement:
+ *  - a callable of at most INLINE_SIZE bytes with a noexcept move lives inside the task, so the usual lambda (a few
+ *    captured pointers) or a std::packaged_task costs no allocation;
+ *  - a larger one is moved to the heap, the task then only keeps the pointer;
+ *  - move-only callables are fine, the task is never copied.
+ * One table of function pointers per callable type replaces the virtual functions of a type-erased base class, so
+ * the whole task is one cache line.
+ */
+class MyTask {
+public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+private:
+    struct Ops {
+        void (*invoke_)(void*);
+        // move the callable from src into dst, then destroy it in src
+        void (*relocate_)(void* dst, void* src) noexcept;
+        void (*destroy_)(void*) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool IS_INLINE = sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<F>;
+
+    template <typename F>
+    static constexpr Ops INLINE_OPS = {
+        [](void* buffer) { (*std::launder(static_cast<F*>(buffer)))(); },
+        [](void* dst, void* src) noexcept {
+            F* from = std::launder(static_cast<F*>(src));
+            ::new(dst) F(std::move(*from));
+            from->~F();
+        },
+        [](void* buffer) noexcept { std::launder(static_cast<F*>(buffer))->~F(); }
+    };
+
+    // the buffer holds an F*
+    template <typename F>
+    static constexpr Ops HEAP_OPS = {
+        [](void* buffer) { (**static_cast<F**>(buffer))(); },
+        [](void* dst, void* src) noexcept { *static_cast<F**>(dst) = *static_cast<F**>(src); },
+        [](void* buffer) noexcept { delete *static_cast<F**>(buffer); }
+    };
+
+    alignas(std::max_align_t) unsigned char buffer_[INLINE_SIZE];
+    // null for an empty task
+    const Ops* ops_;
+
+    void reset() noexcept {
+        if(ops_) {
+            ops_->destroy_(buffer_);
+            ops_ = nullptr;
+        }
+    }
+
+public:
+    MyTask() noexcept: ops_(nullptr) {}
+
+    template <typename Callable>
+    requires (!std::is_same_v<std::decay_t<Callable>, MyTask>) && std::is_invocable_v<std::decay_t<Callable>&>
+    MyTask(Callable&& func): ops_(nullptr) {
+        using F = std::decay_t<Callable>;
+        if constexpr (IS_INLINE<F>) {
+            ::new(static_cast<void*>(buffer_)) F(std::forward<Callable>(func));
+            ops_ = &INLINE_OPS<F>;
+        } else {
+            *reinterpret_cast<F**>(buffer_) = new F(std::forward<Callable>(func));
+            ops_ = &HEAP_OPS<F>;
+        }
+    }
+
+    MyTask(MyTask&& other) noexcept: ops_(other.ops_) {
+        if(ops_) {
+            ops_->relocate_(buffer_, other.buffer_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    MyTask& operator=(MyTask&& other) noexcept {
+        if(this == &other) {
+            return *this;
+        }
+        reset();
+        if(other.ops_) {
+            other.ops_->relocate_(buffer_, other.buffer_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+        return *this;
+    }
+
+    MyTask(const MyTask&) = delete;
+    MyTask& operator=(const MyTask&) = delete;
+
+    ~MyTask() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    void operator()() {
+        ops_->invoke_(buffer_);
+    }
+
+    // true if a callable of type F is stored without allocating
+    template <typename F>
+    static constexpr bool fits_inline() {
+        return IS_INLINE<std::decay_t<F>>;
+    }
+};
+
+static_assert(sizeof(MyTask) == 64, "a task should fill exactly one cache line");
+
+#endif //MY_TASK_H
@@ -0,0 +1,168 @@
+//
+// Created by Charles Green on 7/1/25.
+//
+
+#ifndef MY_HAZARD_POINTER_H
+#define MY_HAZARD_POINTER_H
+#include <assert.h>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+// aidding class
+class HazardPool {
+    static constexpr int POOL_SIZE = 1024;
+    struct HazardPointerSlot {
+        std::atomic<void*> ptr_;
+        std::atomic<bool> occupied_;
+        HazardPointerSlot(): ptr_(nullptr), occupied_(false) {}
+        HazardPointerSlot(const HazardPointerSlot&) = delete;
+        HazardPointerSlot& operator=(const HazardPointerSlot&) = delete;
+    };
+    HazardPointerSlot pool_[POOL_SIZE];
+public:
+    struct HazardPointerWrapper {
+    private:
+        friend class HazardPool;
+        HazardPointerSlot* hptr_;
+    public:
+        HazardPointerWrapper(): hptr_(nullptr) {}
+        // the only reason we need a wrapper is to use its desturctor
+        ~HazardPointerWrapper() {
+            // restore the state of the slot allocated
+            if(hptr_) {
+                hptr_->ptr_.store(nullptr);
+                hptr_->occupied_.store(false);
+            }
+        }
+        std::atomic<void*>& retreive_hazard_pointer() const {
+            return hptr_->ptr_;
+        }
+        bool initialized() const {
+            return hptr_ != nullptr;
+        }
+    };
+    HazardPool() {
+        for(int i=0;i<POOL_SIZE;++i) {
+            pool_[i].ptr_.store(nullptr);
+        }
+    }
+    void allocate_into_wrapper(HazardPointerWrapper& wrapper) {
+        for(int i=0;i<POOL_SIZE;++i) {
+            bool expect = false;
+            if(pool_[i].occupied_.compare_exchange_strong(expect, true)) {
+                wrapper.hptr_ = &pool_[i];
+                return;
+            }
+        }
+        throw std::runtime_error("hazard pool is out of space");
+    }
+    // shared by containers that need several hazard pointers per thread, see ThreadHazardPointers
+    static HazardPool& global() {
+        static HazardPool pool;
+        return pool;
+    }
+    bool safe_to_clean(void* ptr) const {
+        for(int i=0;i<POOL_SIZE;++i) {
+            if(pool_[i].ptr_.load() == ptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// this is mysterious
+template <typename T>
+void do_delete(void* ptr) {
+    delete static_cast<T*>(ptr);
+}
+
+class HazardDustbin {
+    struct BinNode {
+        void* ptr_;
+        std::function<void(void*)> deletor_;
+        BinNode* next;
+        template <typename T>
+        BinNode(T* ptr): ptr_(ptr), deletor_(&do_delete<T>) {}
+        BinNode(): ptr_(nullptr), deletor_(nullptr), next(nullptr) {}
+        ~BinNode() {
+            if(ptr_) {
+                deletor_(ptr_);
+            }
+        }
+    };
+    std::atomic<BinNode*> dustbin_head_;
+    const HazardPool& reference_pool_;
+public:
+    HazardDustbin(const HazardPool& reference_pool): dustbin_head_(nullptr), reference_pool_(reference_pool) {}
+    ~HazardDustbin() {
+        // a correct state should be already empty
+        assert(dustbin_head_.load() == nullptr);
+    }
+    // thread safe
+    template <typename T>
+    void add_to_dustbin(T* ptr) {
+        BinNode* new_node = new BinNode(ptr);
+        new_node->next = dustbin_head_.load();
+        while(!dustbin_head_.compare_exchange_weak(new_node->next, new_node));
+    }
+    // thread safe
+    void insert_back(BinNode* head, BinNode* tail) {
+        assert(tail != nullptr);
+        tail->next = dustbin_head_.load();
+        while (!dustbin_head_.compare_exchange_weak(tail->next, head));
+    }
+    // thread safe
+    void try_to_clean() {
+        BinNode* head = dustbin_head_.exchange(nullptr);
+        BinNode cannot_clean;
+        BinNode* cannot_clean_head = &cannot_clean;
+        BinNode* cannot_clean_tail = cannot_clean_head;
+
+        BinNode* curr = head;
+        while (curr) {
+            // check the retired pointer, not the bin node wrapping it
+            if(reference_pool_.safe_to_clean(curr->ptr_)) {
+                BinNode* next = curr->next;
+                delete curr;
+                curr = next;
+            } else {
+                cannot_clean_tail->next = curr;
+                cannot_clean_tail = curr;
+                curr = curr->next;
+            }
+        }
+        if(cannot_clean_head->next) {
+            insert_back(cannot_clean_head->next, cannot_clean_tail);
+        }
+    }
+};
+
+/**
+ * SLOT_NUM hazard pointers per thread, taken from HazardPool::global() on first use and given back when the thread
+ * exits. MyLockFreeStack2 gets away with a single slot because it only ever dereferences the head, traversals of a
+ * linked structure have to protect a window of consecutive nodes.
+ */
+template <int SLOT_NUM>
+class ThreadHazardPointers {
+public:
+    static std::atomic<void*>& get(int idx) {
+        assert(idx >= 0 && idx < SLOT_NUM);
+        thread_local static HazardPool::HazardPointerWrapper wrappers[SLOT_NUM];
+        if(!wrappers[idx].initialized()) {
+            HazardPool::global().allocate_into_wrapper(wrappers[idx]);
+        }
+        return wrappers[idx].retreive_hazard_pointer();
+    }
+    // clears every slot of the calling thread when it goes out of scope
+    struct Clearer {
+        ~Clearer() {
+            for(int i=0;i<SLOT_NUM;++i) {
+                get(i).store(nullptr, std::memory_order_release);
+            }
+        }
+    };
+};
+
+#endif //MY_HAZARD_POINTER_H
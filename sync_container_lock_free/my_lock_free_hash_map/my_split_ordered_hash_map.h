@@ -0,0 +1,363 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_SPLIT_ORDERED_HASH_MAP_H
+#define MY_SPLIT_ORDERED_HASH_MAP_H
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "../my_hazard_pointer/my_hazard_pointer.h"
+
+/**
+ * Lock-free split-ordered hash map (Shalev & Shavit), same interface as MySyncHashMap.
+ *
+ * All elements live in ONE Harris-Michael ordered list (see MyLockFreeOrderedList), sorted by their split-order key:
+ * the bit-reversed hash with the lowest bit set. Bucket b is just a shortcut pointer to a dummy node whose key is
+ * reverse(b) (lowest bit clear), which sorts right before every element of bucket b. Doubling the bucket count never
+ * moves an element: bucket b + size is initialized lazily by inserting its dummy after the dummy of its parent b.
+ *
+ * The shortcut pointers live in a two level directory: a fixed top array of segments, each segment allocated on first
+ * use with a CAS, so the directory grows without copying either.
+ *
+ * Dummy nodes are never removed while the map is alive, so only element nodes and replaced values are reclaimed, with
+ * the hazard pointers of my_hazard_pointer.h. A thread uses four slots: next, curr, prev for the list traversal and one
+ * more for the value it copies out.
+ */
+template <typename KT, typename VT, typename Hash=std::hash<KT>>
+class MySplitOrderedHashMap {
+    static constexpr uintptr_t MARK_BIT = 1;
+    static constexpr int HP_NEXT = 0;
+    static constexpr int HP_CURR = 1;
+    static constexpr int HP_PREV = 2;
+    static constexpr int HP_VALUE = 3;
+    using Hazards = ThreadHazardPointers<4>;
+
+    static constexpr size_t SEGMENT_SIZE = 4096;
+    static constexpr size_t SEGMENT_NUM = 1024;
+    static constexpr size_t MAX_BUCKET_NUM = SEGMENT_SIZE * SEGMENT_NUM;
+    static constexpr size_t MAX_LOAD_FACTOR = 2;
+    static constexpr uint32_t CLEAN_INTERVAL = 64;
+
+    struct ListNode {
+        const uint64_t so_key_;
+        // next node address | MARK_BIT
+        std::atomic<uintptr_t> next_;
+        explicit ListNode(uint64_t so_key): so_key_(so_key), next_(0) {}
+        bool is_dummy() const {
+            return (so_key_ & 1) == 0;
+        }
+    };
+    struct DataNode: ListNode {
+        const KT key_;
+        // swapped by insertOrUpdate, the old value is retired
+        std::atomic<VT*> value_;
+        template <typename KK>
+        DataNode(uint64_t so_key, KK&& key, VT* value): ListNode(so_key), key_(std::forward<KK>(key)), value_(value) {}
+        ~DataNode() {
+            delete value_.load(std::memory_order_relaxed);
+        }
+    };
+    static_assert(alignof(ListNode) > MARK_BIT, "lowest pointer bit must be free");
+
+    static ListNode* to_node(uintptr_t word) {
+        return reinterpret_cast<ListNode*>(word & ~MARK_BIT);
+    }
+    static uintptr_t to_word(ListNode* node, bool marked = false) {
+        return reinterpret_cast<uintptr_t>(node) | (marked ? MARK_BIT : 0);
+    }
+    static void delete_node(ListNode* node) {
+        if(node->is_dummy()) {
+            delete node;
+        } else {
+            delete static_cast<DataNode*>(node);
+        }
+    }
+
+    static uint64_t reverse_bits(uint64_t x) {
+        x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+        x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+        return (x >> 32) | (x << 32);
+    }
+    static uint64_t regular_key(uint64_t hash) {
+        return reverse_bits(hash) | 1;
+    }
+    static uint64_t dummy_key(size_t bucket) {
+        return reverse_bits(bucket);
+    }
+    // bucket with its highest set bit cleared
+    static size_t parent_of(size_t bucket) {
+        size_t msb = size_t(1) << (63 - __builtin_clzll(bucket));
+        return bucket & ~msb;
+    }
+
+    // the result of search(): *prev_ == curr_ at the time we looked, and next_ == curr_->next_ unmarked
+    struct Window {
+        std::atomic<uintptr_t>* prev_;
+        ListNode* curr_;
+        ListNode* next_;
+    };
+
+    Hash hasher_;
+    ListNode* head_;
+    std::unique_ptr<std::atomic<std::atomic<ListNode*>*>[]> segments_;
+    std::atomic<size_t> bucket_num_;
+    // counted after the link and after the unlink, so a racing erase can take it below 0 for a moment
+    std::atomic<long> count_;
+    HazardDustbin dustbin_;
+    std::atomic<uint32_t> retire_cnt_;
+
+    template <typename T>
+    void retire(T* ptr) {
+        dustbin_.add_to_dustbin(ptr);
+        if(retire_cnt_.fetch_add(1, std::memory_order_relaxed) % CLEAN_INTERVAL == CLEAN_INTERVAL - 1) {
+            dustbin_.try_to_clean();
+        }
+    }
+
+    std::atomic<ListNode*>& bucket_slot(size_t bucket) {
+        std::atomic<std::atomic<ListNode*>*>& segment = segments_[bucket / SEGMENT_SIZE];
+        std::atomic<ListNode*>* seg = segment.load(std::memory_order_acquire);
+        if(seg == nullptr) {
+            std::atomic<ListNode*>* fresh = new std::atomic<ListNode*>[SEGMENT_SIZE];
+            for(size_t i = 0; i < SEGMENT_SIZE; ++i) {
+                fresh[i].store(nullptr, std::memory_order_relaxed);
+            }
+            if(segment.compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+                seg = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return seg[bucket % SEGMENT_SIZE];
+    }
+
+    // Harris-Michael search starting right after the dummy node start, which is never freed.
+    // Stops at the first node whose split-order key is greater than so_key, or equal to it and accepted by matches
+    // (regular nodes of different keys may share a split-order key, they are told apart by KT::operator==).
+    template <typename Matches>
+    bool search(ListNode* start, uint64_t so_key, Matches matches, Window& window) {
+        std::atomic<void*>& hp_next = Hazards::get(HP_NEXT);
+        std::atomic<void*>& hp_curr = Hazards::get(HP_CURR);
+        std::atomic<void*>& hp_prev = Hazards::get(HP_PREV);
+    try_again:
+        std::atomic<uintptr_t>* prev = &start->next_;
+        ListNode* curr = to_node(prev->load());
+        hp_curr.store(curr);
+        if(prev->load() != to_word(curr)) {
+            goto try_again;
+        }
+        while(true) {
+            if(curr == nullptr) {
+                window = Window{prev, nullptr, nullptr};
+                return false;
+            }
+            uintptr_t next_word = curr->next_.load();
+            ListNode* next = to_node(next_word);
+            hp_next.store(next);
+            if(curr->next_.load() != next_word) {
+                goto try_again;
+            }
+            if(prev->load() != to_word(curr)) {
+                goto try_again;
+            }
+            if(!(next_word & MARK_BIT)) {
+                if(curr->so_key_ > so_key) {
+                    window = Window{prev, curr, next};
+                    return false;
+                }
+                if(curr->so_key_ == so_key && matches(curr)) {
+                    window = Window{prev, curr, next};
+                    return true;
+                }
+                prev = &curr->next_;
+                hp_prev.store(curr);
+            } else {
+                uintptr_t expected = to_word(curr);
+                if(!prev->compare_exchange_strong(expected, to_word(next))) {
+                    goto try_again;
+                }
+                retire(static_cast<DataNode*>(curr));
+            }
+            curr = next;
+            hp_curr.store(next);
+        }
+    }
+
+    ListNode* get_bucket(size_t bucket) {
+        std::atomic<ListNode*>& slot = bucket_slot(bucket);
+        ListNode* dummy = slot.load(std::memory_order_acquire);
+        if(dummy == nullptr) {
+            dummy = initialize_bucket(bucket);
+        }
+        return dummy;
+    }
+
+    ListNode* initialize_bucket(size_t bucket) {
+        ListNode* parent = get_bucket(parent_of(bucket));
+        uint64_t so_key = dummy_key(bucket);
+        auto is_dummy = [](ListNode* node) {
+            return node->is_dummy();
+        };
+        ListNode* dummy = new ListNode(so_key);
+        Window window;
+        while(true) {
+            if(search(parent, so_key, is_dummy, window)) {
+                // another thread linked the same dummy first
+                delete dummy;
+                dummy = window.curr_;
+                break;
+            }
+            dummy->next_.store(to_word(window.curr_), std::memory_order_relaxed);
+            uintptr_t expected = to_word(window.curr_);
+            if(window.prev_->compare_exchange_strong(expected, to_word(dummy))) {
+                break;
+            }
+        }
+        ListNode* expected = nullptr;
+        bucket_slot(bucket).compare_exchange_strong(expected, dummy, std::memory_order_acq_rel);
+        return dummy;
+    }
+
+    // the dummy node heading key's bucket
+    ListNode* bucket_of(size_t hash) {
+        return get_bucket(hash & (bucket_num_.load(std::memory_order_acquire) - 1));
+    }
+
+    // copy the value of a node protected by HP_CURR
+    void read_value(DataNode* node, VT& placeholder) {
+        std::atomic<void*>& hp_value = Hazards::get(HP_VALUE);
+        VT* value = node->value_.load();
+        // the same publish-then-validate dance as MyLockFreeStack2::pop_head
+        while(true) {
+            hp_value.store(value);
+            VT* again = node->value_.load();
+            if(again == value) {
+                break;
+            }
+            value = again;
+        }
+        placeholder = *value;
+    }
+
+public:
+    MySplitOrderedHashMap(size_t bucket_num = 16, const Hash& hasher = Hash()): hasher_(hasher),
+    head_(new ListNode(dummy_key(0))), segments_(new std::atomic<std::atomic<ListNode*>*>[SEGMENT_NUM]),
+    bucket_num_(2), count_(0), dustbin_(HazardPool::global()), retire_cnt_(0) {
+        for(size_t i = 0; i < SEGMENT_NUM; ++i) {
+            segments_[i].store(nullptr, std::memory_order_relaxed);
+        }
+        // a power of two, buckets are initialized lazily anyway
+        while(bucket_num_.load(std::memory_order_relaxed) < bucket_num &&
+            bucket_num_.load(std::memory_order_relaxed) < MAX_BUCKET_NUM) {
+            bucket_num_.store(bucket_num_.load(std::memory_order_relaxed) * 2, std::memory_order_relaxed);
+        }
+        bucket_slot(0).store(head_, std::memory_order_release);
+    }
+    MySplitOrderedHashMap(const MySplitOrderedHashMap&) = delete;
+    MySplitOrderedHashMap& operator=(const MySplitOrderedHashMap&) = delete;
+    // no other thread may use the map while it is destroyed
+    ~MySplitOrderedHashMap() {
+        ListNode* curr = head_;
+        while(curr) {
+            ListNode* next = to_node(curr->next_.load());
+            delete_node(curr);
+            curr = next;
+        }
+        for(size_t i = 0; i < SEGMENT_NUM; ++i) {
+            delete[] segments_[i].load();
+        }
+        dustbin_.try_to_clean();
+    }
+
+    bool getValue(const KT& key, VT& placeholder) {
+        typename Hazards::Clearer clearer;
+        size_t hash = hasher_(key);
+        Window window;
+        bool found = search(bucket_of(hash), regular_key(hash), [&key](ListNode* node) {
+            return static_cast<DataNode*>(node)->key_ == key;
+        }, window);
+        if(!found) {
+            return false;
+        }
+        read_value(static_cast<DataNode*>(window.curr_), placeholder);
+        return true;
+    }
+
+    // return true for insert and false for update
+    template<typename KK, typename VV>
+    bool insertOrUpdate(KK&& key, VV&& value) {
+        typename Hazards::Clearer clearer;
+        size_t hash = hasher_(key);
+        uint64_t so_key = regular_key(hash);
+        ListNode* bucket = bucket_of(hash);
+        std::unique_ptr<DataNode> new_node = std::make_unique<DataNode>(so_key, std::forward<KK>(key),
+            new VT(std::forward<VV>(value)));
+        const KT& k = new_node->key_;
+        auto matches = [&k](ListNode* node) {
+            return static_cast<DataNode*>(node)->key_ == k;
+        };
+        Window window;
+        while(true) {
+            if(search(bucket, so_key, matches, window)) {
+                VT* new_value = new_node->value_.exchange(nullptr, std::memory_order_relaxed);
+                VT* old_value = static_cast<DataNode*>(window.curr_)->value_.exchange(new_value);
+                retire(old_value);
+                return false;
+            }
+            new_node->next_.store(to_word(window.curr_), std::memory_order_relaxed);
+            uintptr_t expected = to_word(window.curr_);
+            if(window.prev_->compare_exchange_strong(expected, to_word(new_node.get()))) {
+                new_node.release();
+                break;
+            }
+        }
+        size_t bucket_num = bucket_num_.load(std::memory_order_relaxed);
+        if(count_.fetch_add(1, std::memory_order_relaxed) + 1 > static_cast<long>(bucket_num * MAX_LOAD_FACTOR) &&
+            bucket_num < MAX_BUCKET_NUM) {
+            // doubling is a single CAS, the new buckets fill themselves in on first use
+            bucket_num_.compare_exchange_strong(bucket_num, bucket_num * 2);
+        }
+        return true;
+    }
+
+    // true if key exists
+    bool eraseEntry(const KT& key) {
+        typename Hazards::Clearer clearer;
+        size_t hash = hasher_(key);
+        uint64_t so_key = regular_key(hash);
+        ListNode* bucket = bucket_of(hash);
+        auto matches = [&key](ListNode* node) {
+            return static_cast<DataNode*>(node)->key_ == key;
+        };
+        Window window;
+        while(true) {
+            if(!search(bucket, so_key, matches, window)) {
+                return false;
+            }
+            uintptr_t expected = to_word(window.next_);
+            if(!window.curr_->next_.compare_exchange_strong(expected, to_word(window.next_, true))) {
+                continue;
+            }
+            expected = to_word(window.curr_);
+            if(window.prev_->compare_exchange_strong(expected, to_word(window.next_))) {
+                retire(static_cast<DataNode*>(window.curr_));
+            } else {
+                search(bucket, so_key, matches, window);
+            }
+            count_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    size_t size() const {
+        return std::max<long>(count_.load(std::memory_order_relaxed), 0);
+    }
+};
+
+#endif //MY_SPLIT_ORDERED_HASH_MAP_H
@@ -0,0 +1,200 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_LOCK_FREE_ORDERED_LIST_H
+#define MY_LOCK_FREE_ORDERED_LIST_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "../my_hazard_pointer/my_hazard_pointer.h"
+
+/**
+ * Harris-Michael lock-free ordered list, a lock-free alternative to MySyncForwardList for ordered keys.
+ *
+ * The lowest bit of a node's next_ word is the "deleted" mark. erase() first marks the victim's next_ (so nobody can
+ * link behind it any more), then tries to swing the predecessor past it; any traversal that meets a marked node helps
+ * to unlink it. Keys are kept sorted so every search stops at the first key that is not smaller than the target.
+ *
+ * Memory is reclaimed with the hazard pointers of my_hazard_pointer.h. A traversal stands on three nodes at a time:
+ * prev (whose next_ we may CAS), curr and next, so each thread uses three slots:
+ *   HP_NEXT - next, published before we validate curr->next_
+ *   HP_CURR - curr
+ *   HP_PREV - the node owning *prev (the head word needs no protection)
+ * Advancing copies curr into HP_PREV and next into HP_CURR, each of which is already protected by the other slot,
+ * so a node is never left unprotected while we still use it.
+ */
+template <typename KT, typename VT, typename Compare = std::less<KT>>
+class MyLockFreeOrderedList {
+    static constexpr uintptr_t MARK_BIT = 1;
+    static constexpr int HP_NEXT = 0;
+    static constexpr int HP_CURR = 1;
+    static constexpr int HP_PREV = 2;
+    using Hazards = ThreadHazardPointers<3>;
+    // scan the dustbin once every this many retirements
+    static constexpr uint32_t CLEAN_INTERVAL = 64;
+
+    struct ListNode {
+        const KT key_;
+        // immutable once published, which is what makes reading it under a hazard pointer safe
+        const VT value_;
+        // next node address | MARK_BIT
+        std::atomic<uintptr_t> next_;
+        template <typename KK, typename VV>
+        ListNode(KK&& key, VV&& value): key_(std::forward<KK>(key)), value_(std::forward<VV>(value)), next_(0) {}
+    };
+    static_assert(alignof(ListNode) > MARK_BIT, "lowest pointer bit must be free");
+
+    static ListNode* to_node(uintptr_t word) {
+        return reinterpret_cast<ListNode*>(word & ~MARK_BIT);
+    }
+    static uintptr_t to_word(ListNode* node, bool marked = false) {
+        return reinterpret_cast<uintptr_t>(node) | (marked ? MARK_BIT : 0);
+    }
+
+    // the result of search(): *prev == curr at the time we looked, and next == curr->next_ unmarked
+    struct Window {
+        std::atomic<uintptr_t>* prev_;
+        ListNode* curr_;
+        ListNode* next_;
+    };
+
+    std::atomic<uintptr_t> head_;
+    Compare less_;
+    HazardDustbin dustbin_;
+    std::atomic<uint32_t> retire_cnt_;
+
+    void retire(ListNode* node) {
+        dustbin_.add_to_dustbin(node);
+        if(retire_cnt_.fetch_add(1, std::memory_order_relaxed) % CLEAN_INTERVAL == CLEAN_INTERVAL - 1) {
+            dustbin_.try_to_clean();
+        }
+    }
+
+    // true if key is found at window.curr_, otherwise window.curr_ is the first node with a greater key (or null)
+    bool search(const KT& key, Window& window) {
+        std::atomic<void*>& hp_next = Hazards::get(HP_NEXT);
+        std::atomic<void*>& hp_curr = Hazards::get(HP_CURR);
+        std::atomic<void*>& hp_prev = Hazards::get(HP_PREV);
+    try_again:
+        std::atomic<uintptr_t>* prev = &head_;
+        ListNode* curr = to_node(prev->load());
+        hp_curr.store(curr);
+        // the same publish-then-validate dance as MyLockFreeStack2::pop_head
+        if(prev->load() != to_word(curr)) {
+            goto try_again;
+        }
+        while(true) {
+            if(curr == nullptr) {
+                window = Window{prev, nullptr, nullptr};
+                return false;
+            }
+            uintptr_t next_word = curr->next_.load();
+            ListNode* next = to_node(next_word);
+            hp_next.store(next);
+            if(curr->next_.load() != next_word) {
+                goto try_again;
+            }
+            // curr could have been unlinked from prev while we were protecting next
+            if(prev->load() != to_word(curr)) {
+                goto try_again;
+            }
+            if(!(next_word & MARK_BIT)) {
+                if(!less_(curr->key_, key)) {
+                    window = Window{prev, curr, next};
+                    return !less_(key, curr->key_);
+                }
+                prev = &curr->next_;
+                hp_prev.store(curr);
+            } else {
+                // curr is logically deleted, help unlink it
+                uintptr_t expected = to_word(curr);
+                if(!prev->compare_exchange_strong(expected, to_word(next))) {
+                    goto try_again;
+                }
+                retire(curr);
+            }
+            curr = next;
+            hp_curr.store(next);
+        }
+    }
+
+public:
+    MyLockFreeOrderedList(const Compare& less = Compare()): head_(0), less_(less),
+    dustbin_(HazardPool::global()), retire_cnt_(0) {}
+    MyLockFreeOrderedList(const MyLockFreeOrderedList&) = delete;
+    MyLockFreeOrderedList& operator=(const MyLockFreeOrderedList&) = delete;
+    // no other thread may operate on the list while it is destroyed
+    ~MyLockFreeOrderedList() {
+        ListNode* curr = to_node(head_.load());
+        while(curr) {
+            ListNode* next = to_node(curr->next_.load());
+            delete curr;
+            curr = next;
+        }
+        // every hazard pointer has been cleared by now, so the dustbin empties completely
+        dustbin_.try_to_clean();
+    }
+
+    // false if key already exists, the existing value is left untouched
+    template <typename KK, typename VV>
+    bool insert(KK&& key, VV&& value) {
+        typename Hazards::Clearer clearer;
+        ListNode* new_node = new ListNode(std::forward<KK>(key), std::forward<VV>(value));
+        Window window;
+        while(true) {
+            if(search(new_node->key_, window)) {
+                delete new_node;
+                return false;
+            }
+            new_node->next_.store(to_word(window.curr_), std::memory_order_relaxed);
+            uintptr_t expected = to_word(window.curr_);
+            if(window.prev_->compare_exchange_strong(expected, to_word(new_node))) {
+                return true;
+            }
+        }
+    }
+
+    // true if key existed
+    bool erase(const KT& key) {
+        typename Hazards::Clearer clearer;
+        Window window;
+        while(true) {
+            if(!search(key, window)) {
+                return false;
+            }
+            // logical deletion: whoever marks next_ owns the removal
+            uintptr_t expected = to_word(window.next_);
+            if(!window.curr_->next_.compare_exchange_strong(expected, to_word(window.next_, true))) {
+                continue;
+            }
+            expected = to_word(window.curr_);
+            if(window.prev_->compare_exchange_strong(expected, to_word(window.next_))) {
+                retire(window.curr_);
+            } else {
+                // someone changed prev, let a fresh search unlink (and retire) the marked node
+                search(key, window);
+            }
+            return true;
+        }
+    }
+
+    bool contains(const KT& key) {
+        typename Hazards::Clearer clearer;
+        Window window;
+        return search(key, window);
+    }
+
+    // copy the value out while curr is still protected
+    bool find(const KT& key, VT& placeholder) {
+        typename Hazards::Clearer clearer;
+        Window window;
+        if(!search(key, window)) {
+            return false;
+        }
+        placeholder = window.curr_->value_;
+        return true;
+    }
+};
+
+#endif //MY_LOCK_FREE_ORDERED_LIST_H
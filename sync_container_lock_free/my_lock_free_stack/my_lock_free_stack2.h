@@ -5,132 +5,7 @@
 #ifndef MYLOCKFREESTACK2_H
 #define MYLOCKFREESTACK2_H
 #include <assert.h>
-
-// aidding class
-class HazardPool {
-    static constexpr int POOL_SIZE = 1024;
-    struct HazardPointerSlot {
-        std::atomic<void*> ptr_;
-        std::atomic<bool> occupied_;
-        HazardPointerSlot(): ptr_(nullptr), occupied_(false) {}
-        HazardPointerSlot(const HazardPointerSlot&) = delete;
-        HazardPointerSlot& operator=(const HazardPointerSlot&) = delete;
-    };
-    HazardPointerSlot pool_[POOL_SIZE];
-public:
-    struct HazardPointerWrapper {
-    private:
-        friend class HazardPool;
-        HazardPointerSlot* hptr_;
-    public:
-        HazardPointerWrapper(): hptr_(nullptr) {}
-        // the only reason we need a wrapper is to use its desturctor
-        ~HazardPointerWrapper() {
-            // restore the state of the slot allocated
-            if(hptr_) {
-                hptr_->ptr_.store(nullptr);
-                hptr_->occupied_.store(false);
-            }
-        }
-        std::atomic<void*>& retreive_hazard_pointer() const {
-            return hptr_->ptr_;
-        }
-        bool initialized() const {
-            return hptr_ != nullptr;
-        }
-    };
-    HazardPool() {
-        for(int i=0;i<POOL_SIZE;++i) {
-            pool_[i].ptr_.store(nullptr);
-        }
-    }
-    void allocate_into_wrapper(HazardPointerWrapper& wrapper) {
-        for(int i=0;i<POOL_SIZE;++i) {
-            bool expect = false;
-            if(pool_[i].occupied_.compare_exchange_strong(expect, true)) {
-                wrapper.hptr_ = &pool_[i];
-                return;
-            }
-        }
-        throw std::runtime_error("hazard pool is out of space");
-    }
-    bool safe_to_clean(void* ptr) const {
-        for(int i=0;i<POOL_SIZE;++i) {
-            if(pool_[i].ptr_.load() == ptr) {
-                return false;
-            }
-        }
-        return true;
-    }
-};
-
-// this is mysterious
-template <typename T>
-void do_delete(void* ptr) {
-    delete static_cast<T*>(ptr);
-}
-
-class HazardDustbin {
-    struct BinNode {
-        void* ptr_;
-        std::function<void(void*)> deletor_;
-        BinNode* next;
-        template <typename T>
-        BinNode(T* ptr): ptr_(ptr), deletor_(&do_delete<T>) {}
-        BinNode(): ptr_(nullptr), deletor_(nullptr), next(nullptr) {}
-        ~BinNode() {
-            if(ptr_) {
-                deletor_(ptr_);
-            }
-        }
-    };
-    std::atomic<BinNode*> dustbin_head_;
-    const HazardPool& reference_pool_;
-public:
-    HazardDustbin(const HazardPool& reference_pool): dustbin_head_(nullptr), reference_pool_(reference_pool) {}
-    ~HazardDustbin() {
-        // a correct state should be already empty
-        assert(dustbin_head_.load() == nullptr);
-    }
-    // thread safe
-    template <typename T>
-    void add_to_dustbin(T* ptr) {
-        BinNode* new_node = new BinNode(ptr);
-        new_node->next = dustbin_head_.load();
-        while(!dustbin_head_.compare_exchange_weak(new_node->next, new_node));
-    }
-    // thread safe
-    void insert_back(BinNode* head, BinNode* tail) {
-        assert(tail != nullptr);
-        tail->next = dustbin_head_.load();
-        while (!dustbin_head_.compare_exchange_weak(tail->next, head));
-    }
-    // thread safe
-    void try_to_clean() {
-        BinNode* head = dustbin_head_.exchange(nullptr);
-        BinNode cannot_clean;
-        BinNode* cannot_clean_head = &cannot_clean;
-        BinNode* cannot_clean_tail = cannot_clean_head;
-
-        BinNode* curr = head;
-        while (curr) {
-            if(reference_pool_.safe_to_clean(curr)) {
-                BinNode* next = curr->next;
-                delete curr;
-                curr = next;
-            } else {
-                cannot_clean_tail->next = curr;
-                cannot_clean_tail = curr;
-                curr = curr->next;
-            }
-        }
-        if(cannot_clean_head->next) {
-            insert_back(cannot_clean_head->next, cannot_clean_tail);
-        }
-    }
-};
-
-
+#include "../my_hazard_pointer/my_hazard_pointer.h"
 
 template <typename T>
 class MyLockFreeStack2 {
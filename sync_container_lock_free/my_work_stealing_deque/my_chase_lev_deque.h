@@ -0,0 +1,143 @@
+//
+// Created by Charles Green on 11/8/25.
+//
+
+#ifndef MY_CHASE_LEV_DEQUE_H
+#define MY_CHASE_LEV_DEQUE_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+/**
+ * The dynamic circular work-stealing deque of Chase and Lev, with the memory orders of Le et al., "Correct and
+ * Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013):
+ *  - one owner thread pushes and pops at the bottom, LIFO, so it keeps working on what is hot in its cache. Neither
+ *    takes a lock or does a CAS, except pop() racing the thieves for the very last element. push() needs only a
+ *    release store (a plain mov on x86), pop() one seq_cst store, the one fence the algorithm cannot do without;
+ *  - any other thread steals from the top, FIFO, the oldest and usually biggest piece of work, with one CAS on top_;
+ *  - the buffer grows when full. Only the owner grows it, a thief may still be reading the old one, so old buffers
+ *    are kept until the deque dies. Each is half the size of the next, all of them together stay below the live one.
+ * Slots are std::atomic<T>: a thief reads a slot the owner may be overwriting, and only finds out by its failing CAS
+ * that the value is stale. That is why T must be trivially copyable and small enough for a lock-free atomic, a
+ * pointer in practice.
+ */
+template <typename T>
+class MyChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "a thief copies slots the owner may be writing");
+    static_assert(std::atomic<T>::is_always_lock_free, "slots must be lock-free atomics");
+
+    struct Buffer {
+        const int64_t MASK_;
+        std::unique_ptr<std::atomic<T>[]> slots_;
+
+        explicit Buffer(int64_t capacity): MASK_(capacity - 1), slots_(new std::atomic<T>[capacity]) {}
+
+        int64_t capacity() const {
+            return MASK_ + 1;
+        }
+        T get(int64_t i) const {
+            return slots_[i & MASK_].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T value) {
+            slots_[i & MASK_].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    // thieves hammer top_, keep the owner's bottom_ off their cache line
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<Buffer*> buffer_;
+    // every buffer ever used, only the owner touches it
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+    Buffer* grow(Buffer* old, int64_t top, int64_t bottom) {
+        auto bigger = std::make_unique<Buffer>(old->capacity() * 2);
+        for(int64_t i = top; i < bottom; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        Buffer* ret = bigger.get();
+        buffers_.push_back(std::move(bigger));
+        // release: a thief that sees the new buffer sees its content
+        buffer_.store(ret, std::memory_order_release);
+        return ret;
+    }
+
+public:
+    // capacity is rounded up to a power of two
+    explicit MyChaseLevDeque(int64_t capacity = 256): top_(0), bottom_(0) {
+        int64_t rounded = 1;
+        while(rounded < capacity) {
+            rounded <<= 1;
+        }
+        buffers_.push_back(std::make_unique<Buffer>(rounded));
+        buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+    }
+    MyChaseLevDeque(const MyChaseLevDeque&) = delete;
+    MyChaseLevDeque& operator=(const MyChaseLevDeque&) = delete;
+
+    // owner only
+    void push(T value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+        if(bottom - top > buffer->capacity() - 1) {
+            buffer = grow(buffer, top, bottom);
+        }
+        buffer->put(bottom, value);
+        // release: a thief that sees the new bottom_ sees the slot
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    // owner only, the newest element
+    std::optional<T> pop() {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+        // CRITICAL: seq_cst, the claim on slot bottom must be visible to the thieves before we read top_, or a thief
+        // and we could both take the same element. This is the fence of the paper folded into the store
+        bottom_.store(bottom, std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_seq_cst);
+        if(top > bottom) {
+            // empty, undo the claim
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T value = buffer->get(bottom);
+        if(top == bottom) {
+            // the last one, the thieves may be after it too, whoever moves top_ first gets it
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            if(!won) {
+                return std::nullopt;
+            }
+        }
+        return value;
+    }
+
+    // any thread, the oldest element. nullopt when empty or when the owner or another thief won the race for it
+    std::optional<T> steal() {
+        int64_t top = top_.load(std::memory_order_seq_cst);
+        // seq_cst, pairs with the claim in pop()
+        int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+        if(top >= bottom) {
+            return std::nullopt;
+        }
+        Buffer* buffer = buffer_.load(std::memory_order_acquire);
+        T value = buffer->get(top);
+        // the value is ours only if nobody moved top_ meanwhile, otherwise it may already be overwritten
+        if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // a snapshot, exact only when nobody pushes, pops or steals concurrently
+    bool empty() const {
+        return top_.load(std::memory_order_relaxed) >= bottom_.load(std::memory_order_relaxed);
+    }
+};
+
+#endif //MY_CHASE_LEV_DEQUE_H
@@ -0,0 +1,214 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_COMPACT_FORWARD_LIST_H
+#define MY_COMPACT_FORWARD_LIST_H
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+/**
+ * Same hand-over-hand protocol and interface as MySyncForwardList, with a smaller node.
+ *
+ * MySyncForwardList::ListNode carries a std::mutex (40 bytes on linux), a shared_ptr to a separately allocated T and a
+ * unique_ptr next: three allocations (node, control block + T) and ~100 bytes of overhead per element.
+ * Here the node is one allocation holding T inline plus a single word: the next pointer whose lowest bit is a spin
+ * lock. The bit protects the link *out of* a node, which is exactly what hand-over-hand locking needs, and the head of
+ * the list is such a word as well, so no sentinel T is needed.
+ *
+ * Spin locks are fine here because every critical section is a few loads and stores, except the user callbacks which
+ * run while holding at most two lock bits, just like before.
+ */
+template <typename T>
+class MyCompactForwardList {
+    static constexpr uintptr_t LOCK_BIT = 1;
+    struct ListNode {
+        // next node address | LOCK_BIT
+        std::atomic<uintptr_t> next_;
+        T data_;
+        template <typename U>
+        ListNode(U&& ele): next_(0), data_(std::forward<U>(ele)) {}
+    };
+    static_assert(alignof(ListNode) > LOCK_BIT, "lowest pointer bit must be free");
+
+    static ListNode* to_node(uintptr_t word) {
+        return reinterpret_cast<ListNode*>(word & ~LOCK_BIT);
+    }
+
+    // unique_lock-like guard over one lock bit
+    class LinkLock {
+        std::atomic<uintptr_t>* link_;
+    public:
+        explicit LinkLock(std::atomic<uintptr_t>& link): link_(&link) {
+            uintptr_t word = link_->load(std::memory_order_relaxed);
+            int spins = 0;
+            while(true) {
+                if(!(word & LOCK_BIT) &&
+                    link_->compare_exchange_weak(word, word | LOCK_BIT, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    return;
+                }
+                if(++spins > 64) {
+                    // the holder may have been preempted
+                    std::this_thread::yield();
+                }
+                word = link_->load(std::memory_order_relaxed);
+            }
+        }
+        LinkLock(const LinkLock&) = delete;
+        LinkLock& operator=(const LinkLock&) = delete;
+        LinkLock(LinkLock&& other) noexcept: link_(other.link_) {
+            other.link_ = nullptr;
+        }
+        // like unique_lock, moving into a held lock releases it first
+        LinkLock& operator=(LinkLock&& other) noexcept {
+            if(this != &other) {
+                unlock();
+                link_ = other.link_;
+                other.link_ = nullptr;
+            }
+            return *this;
+        }
+        ~LinkLock() {
+            unlock();
+        }
+        void unlock() {
+            if(link_) {
+                link_->fetch_and(~LOCK_BIT, std::memory_order_release);
+                link_ = nullptr;
+            }
+        }
+        // the lock is held, only the owner may write the link
+        ListNode* next() const {
+            return to_node(link_->load(std::memory_order_relaxed));
+        }
+        void set_next(ListNode* node) {
+            link_->store(reinterpret_cast<uintptr_t>(node) | LOCK_BIT, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<uintptr_t> head_;
+
+public:
+    MyCompactForwardList(): head_(0) {}
+    ~MyCompactForwardList() {
+        ListNode* curr = to_node(head_.load(std::memory_order_relaxed));
+        while(curr) {
+            ListNode* next = to_node(curr->next_.load(std::memory_order_relaxed));
+            delete curr;
+            curr = next;
+        }
+    }
+    MyCompactForwardList(const MyCompactForwardList&) = delete;
+    MyCompactForwardList& operator=(const MyCompactForwardList&) = delete;
+
+    // bytes a single element costs, not counting the allocator's own header
+    static constexpr size_t node_size() {
+        return sizeof(ListNode);
+    }
+
+    // exception safe
+    template <typename U>
+    void push_front(U&& data) {
+        std::unique_ptr<ListNode> new_node = std::make_unique<ListNode>(std::forward<U>(data));
+        LinkLock head_lock(head_);
+        new_node->next_.store(reinterpret_cast<uintptr_t>(head_lock.next()), std::memory_order_relaxed);
+        head_lock.set_next(new_node.release());
+    }
+
+    // true if one element is removed
+    template <typename Condition>
+    bool remove_first_if(Condition cond) {
+        LinkLock prevLock(head_);
+        ListNode* curr = prevLock.next();
+        while(curr) {
+            LinkLock currLock(curr->next_);
+            if(cond(curr->data_)) {
+                prevLock.set_next(currLock.next());
+                prevLock.unlock();
+                // nobody can be spinning on curr's bit: they would need prevLock first, and after the unlink they no
+                // longer reach curr
+                currLock.unlock();
+                delete curr;
+                return true;
+            }
+            prevLock = std::move(currLock);
+            curr = prevLock.next();
+        }
+        return false;
+    }
+
+    template <typename BoolFunction>
+    void for_each_until(BoolFunction boolfunc) {
+        LinkLock prevLock(head_);
+        ListNode* current = prevLock.next();
+        while(current) {
+            // CRITICAL: must get current's bit with prevLock unreleased
+            LinkLock currLock(current->next_);
+            prevLock.unlock();
+            bool kontinue = boolfunc(static_cast<const T&>(current->data_));
+            if(!kontinue)
+                return;
+            prevLock = std::move(currLock);
+            current = prevLock.next();
+        }
+    }
+
+    template <typename VoidFunction>
+    void for_each(VoidFunction voidfunc) {
+        auto wrapper = [&voidfunc](const T& data)->bool {
+            voidfunc(data);
+            return true;
+        };
+        for_each_until(wrapper);
+    }
+
+    // visitor runs on the stored element while it is locked, true if found
+    template <typename BoolFunction, typename Visitor>
+    bool visit_first_if(BoolFunction boolfunc, Visitor visitor) {
+        bool found = false;
+        for_each_until([&](const T& data) {
+            if(boolfunc(data)) {
+                visitor(data);
+                found = true;
+                return false;
+            }
+            return true;
+        });
+        return found;
+    }
+
+    // T lives inside the node, so hand out a copy
+    template <typename BoolFunction>
+    std::shared_ptr<T> find_first_if(BoolFunction boolfunc) {
+        std::shared_ptr<T> ret;
+        visit_first_if(boolfunc, [&ret](const T& data) {
+            ret = std::make_shared<T>(data);
+        });
+        return ret;
+    }
+
+    // Insert at the tail for the same reason as MySyncForwardList::insert_or_update. An update assigns in place.
+    // return true for insert and false for update
+    template <typename BoolFunction, typename U>
+    bool insert_or_update(BoolFunction boolfunc, U&& val) {
+        LinkLock prevLock(head_);
+        ListNode* current = prevLock.next();
+        while(current) {
+            LinkLock currLock(current->next_);
+            prevLock.unlock();
+            if(boolfunc(static_cast<const T&>(current->data_))) {
+                current->data_ = std::forward<U>(val);
+                return false;
+            }
+            prevLock = std::move(currLock);
+            current = prevLock.next();
+        }
+        // prevLock guards the last link, allocating under it keeps the element unique
+        prevLock.set_next(new ListNode(std::forward<U>(val)));
+        return true;
+    }
+};
+
+#endif //MY_COMPACT_FORWARD_LIST_H
@@ -0,0 +1,186 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_LAZY_FORWARD_LIST_H
+#define MY_LAZY_FORWARD_LIST_H
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include "../../my_utility/my_epoch_reclaimer.h"
+
+/**
+ * Lazy synchronization list (Heller et al.), an alternative to MySyncForwardList.
+ *
+ * Readers never lock: they follow next_ pointers inside an epoch guard and skip nodes whose marked_ flag is set.
+ * Writers lock only the pred/curr pair they modify and validate it afterwards (neither is marked and pred still points
+ * to curr), retrying the traversal if some other writer got there first. Removal marks the node first (logical
+ * delete) and then unlinks it (physical delete), so a reader standing on a removed node can still walk off it.
+ *
+ * Nodes are never moved, values are updated in place by swapping the data pointer, and both unlinked nodes and
+ * replaced values go through EpochReclaimer, so nothing is freed while a reader may still look at it.
+ */
+template <typename T>
+class MyLazyForwardList {
+    struct ListNode {
+        // replaced atomically by insert_or_update, readers may hold the old one until they leave their epoch
+        std::atomic<T*> data_;
+        std::atomic<ListNode*> next_;
+        std::atomic<bool> marked_;
+        std::mutex mtx_;
+        template <typename U>
+        ListNode(U&& ele): data_(new T(std::forward<U>(ele))), next_(nullptr), marked_(false) {}
+        ListNode(): data_(nullptr), next_(nullptr), marked_(false) {}
+        ~ListNode() {
+            delete data_.load(std::memory_order_relaxed);
+        }
+    };
+    ListNode fooHead;
+
+    // both locks must be held
+    static bool validate(ListNode* pred, ListNode* curr) {
+        return !pred->marked_.load(std::memory_order_relaxed) &&
+            (curr == nullptr || !curr->marked_.load(std::memory_order_relaxed)) &&
+            pred->next_.load(std::memory_order_relaxed) == curr;
+    }
+
+public:
+    MyLazyForwardList() = default;
+    // no reader can be active while the list itself is destroyed
+    ~MyLazyForwardList() {
+        ListNode* curr = fooHead.next_.load(std::memory_order_relaxed);
+        while(curr) {
+            ListNode* next = curr->next_.load(std::memory_order_relaxed);
+            delete curr;
+            curr = next;
+        }
+    }
+    MyLazyForwardList(const MyLazyForwardList&) = delete;
+    MyLazyForwardList& operator=(const MyLazyForwardList&) = delete;
+
+    template <typename U>
+    void push_front(U&& data) {
+        std::unique_ptr<ListNode> new_node = std::make_unique<ListNode>(std::forward<U>(data));
+        std::lock_guard<std::mutex> mtx(fooHead.mtx_);
+        // fooHead is never marked, no validation needed
+        new_node->next_.store(fooHead.next_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        fooHead.next_.store(new_node.release(), std::memory_order_release);
+    }
+
+    // true if one element is removed
+    template <typename Condition>
+    bool remove_first_if(Condition cond) {
+        EpochReclaimer::Guard guard;
+        while(true) {
+            ListNode* pred = &fooHead;
+            ListNode* curr = pred->next_.load(std::memory_order_acquire);
+            while(curr && (curr->marked_.load(std::memory_order_acquire) ||
+                !cond(*curr->data_.load(std::memory_order_acquire)))) {
+                pred = curr;
+                curr = curr->next_.load(std::memory_order_acquire);
+            }
+            if(!curr) {
+                return false;
+            }
+            std::lock_guard<std::mutex> pred_lock(pred->mtx_);
+            std::lock_guard<std::mutex> curr_lock(curr->mtx_);
+            if(!validate(pred, curr)) {
+                // someone changed pred or curr under our feet, start over
+                continue;
+            }
+            // logical removal first: readers that already stand on curr skip it from now on
+            curr->marked_.store(true, std::memory_order_release);
+            pred->next_.store(curr->next_.load(std::memory_order_relaxed), std::memory_order_release);
+            // curr stays readable (and its mutex lockable) until every current reader has left
+            EpochReclaimer::instance().retire(curr);
+            return true;
+        }
+    }
+
+    // wait-free: no lock is taken, boolfunc may run on a node being removed concurrently
+    template <typename BoolFunction>
+    void for_each_until(BoolFunction boolfunc) {
+        EpochReclaimer::Guard guard;
+        ListNode* current = fooHead.next_.load(std::memory_order_acquire);
+        while(current) {
+            if(!current->marked_.load(std::memory_order_acquire)) {
+                bool kontinue = boolfunc(static_cast<const T&>(*current->data_.load(std::memory_order_acquire)));
+                if(!kontinue)
+                    return;
+            }
+            current = current->next_.load(std::memory_order_acquire);
+        }
+    }
+
+    template <typename VoidFunction>
+    void for_each(VoidFunction voidfunc) {
+        auto wrapper = [&voidfunc](const T& data)->bool {
+            voidfunc(data);
+            return true;
+        };
+        for_each_until(wrapper);
+    }
+
+    // wait-free, visitor sees the first element satisfying boolfunc, true if found
+    template <typename BoolFunction, typename Visitor>
+    bool visit_first_if(BoolFunction boolfunc, Visitor visitor) {
+        bool found = false;
+        for_each_until([&](const T& data) {
+            if(boolfunc(data)) {
+                visitor(data);
+                found = true;
+                return false;
+            }
+            return true;
+        });
+        return found;
+    }
+
+    // the element may be replaced right after we leave the epoch, so return a copy rather than the internal object
+    template <typename BoolFunction>
+    std::shared_ptr<T> find_first_if(BoolFunction boolfunc) {
+        std::shared_ptr<T> ret;
+        visit_first_if(boolfunc, [&ret](const T& data) {
+            ret = std::make_shared<T>(data);
+        });
+        return ret;
+    }
+
+    // Same contract as MySyncForwardList: insert at the tail under the lock of the last node so that two threads
+    // inserting the same element cannot both succeed. Updates swap the data pointer under the node's own lock.
+    // return true for insert and false for update
+    template <typename BoolFunction, typename U>
+    bool insert_or_update(BoolFunction boolfunc, U&& val) {
+        std::unique_ptr<T> new_data = std::make_unique<T>(std::forward<U>(val));
+        EpochReclaimer::Guard guard;
+        while(true) {
+            ListNode* pred = &fooHead;
+            ListNode* curr = pred->next_.load(std::memory_order_acquire);
+            while(curr && (curr->marked_.load(std::memory_order_acquire) ||
+                !boolfunc(*curr->data_.load(std::memory_order_acquire)))) {
+                pred = curr;
+                curr = curr->next_.load(std::memory_order_acquire);
+            }
+            if(curr) {
+                std::lock_guard<std::mutex> curr_lock(curr->mtx_);
+                if(curr->marked_.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                T* old_data = curr->data_.exchange(new_data.release(), std::memory_order_acq_rel);
+                EpochReclaimer::instance().retire(old_data);
+                return false;
+            }
+            std::lock_guard<std::mutex> pred_lock(pred->mtx_);
+            if(!validate(pred, nullptr)) {
+                // pred was removed or someone appended behind it, the element may exist now
+                continue;
+            }
+            std::unique_ptr<ListNode> new_node = std::make_unique<ListNode>();
+            new_node->data_.store(new_data.release(), std::memory_order_relaxed);
+            pred->next_.store(new_node.release(), std::memory_order_release);
+            return true;
+        }
+    }
+};
+
+#endif //MY_LAZY_FORWARD_LIST_H
@@ -40,14 +40,14 @@ public:
         while(curr) {
             std::unique_lock<std::mutex> currLock(curr->mtx_);
             if(cond(*curr->data_)) {
-                // CRITICAL: must use a unique pointer to steal the current->next,
+                // CRITICAL: must use a unique pointer to steal curr from prev->next_,
                 // directly assign prev->next with a new value causing rf of the original prev->next drop to 0,
-                // triggering destructor call
-                std::unique_ptr<ListNode> old_next = std::move(curr->next_);
-                prev->next_ = std::move(old_next->next_);
+                // triggering destructor call while curr->next_ is still needed
+                std::unique_ptr<ListNode> old_curr = std::move(prev->next_);
+                prev->next_ = std::move(curr->next_);
                 // explicitly free prev for higher concurrecy
                 prevLock.unlock();
-                // CRITICAL: must free currLock explicitly: according to pop order, old_next is recycled before currLock,
+                // CRITICAL: must free currLock explicitly: according to pop order, old_curr is recycled before currLock,
                 // resulting in a Node recycled with a member a mutex locked - undefined behavior
                 currLock.unlock();
                 return true;
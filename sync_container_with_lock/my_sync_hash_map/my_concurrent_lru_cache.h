@@ -0,0 +1,259 @@
+//
+// Created by Charles Green on 10/24/25.
+//
+
+#ifndef MY_CONCURRENT_LRU_CACHE_H
+#define MY_CONCURRENT_LRU_CACHE_H
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "my_sync_hash_map.h"
+#include "../../my_utility/my_epoch_reclaimer.h"
+
+/**
+ * A bounded cache approximating LRU with CLOCK (second chance), so that a hit never takes a lock:
+ *  - one MySyncHashMap maps a key to its Entry, get() is a lock-free lookup there followed by a copy of the value;
+ *  - a hit only sets the entry's referenced_ bit, and only if it was clear, so hot entries are not written at all;
+ *  - the entries are split into SHARD_NUM shards by hash, each shard keeps its entries on an intrusive ring with a
+ *    clock hand, a size and a capacity, guarded by a mutex that only put / erase / eviction take;
+ *  - when a shard is full the hand walks the ring: a referenced entry loses its bit and survives one more round,
+ *    the first unreferenced (or expired) one is evicted;
+ *  - an Entry is immutable once published, put() on an existing key publishes a new Entry in its place. Replaced and
+ *    evicted entries go through EpochReclaimer since a reader may still be copying from them.
+ * Entries may carry a time to live, an expired entry counts as a miss and is dropped by the next reader that sees it.
+ */
+template <typename KT, typename VT, typename Hash = std::hash<KT>>
+class MyConcurrentLRUCache {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        const KT key_;
+        const VT value_;
+        // 0 if the entry never expires
+        const int64_t expire_at_;
+        std::atomic<bool> referenced_;
+        // ring links, only touched under the shard mutex
+        Entry* prev_;
+        Entry* next_;
+        Entry(const KT& key, VT&& value, int64_t expire_at): key_(key), value_(std::move(value)),
+        expire_at_(expire_at), referenced_(false), prev_(this), next_(this) {}
+        bool expired(int64_t now) const {
+            return expire_at_ != 0 && now >= expire_at_;
+        }
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mtx_;
+        // the entry the clock hand points at, null if the shard is empty
+        Entry* hand_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;
+    };
+
+    // a counter bumped by many threads, spread over cache lines so hits on different cores do not collide
+    class StripedCounter {
+        static constexpr int STRIPE_NUM = 16;
+        struct alignas(64) Stripe {
+            std::atomic<uint64_t> cnt_{0};
+        };
+        Stripe stripes_[STRIPE_NUM];
+        static int my_stripe() {
+            static thread_local int idx = static_cast<int>(
+                std::hash<std::thread::id>()(std::this_thread::get_id()) % STRIPE_NUM);
+            return idx;
+        }
+    public:
+        void add(uint64_t n = 1) {
+            stripes_[my_stripe()].cnt_.fetch_add(n, std::memory_order_relaxed);
+        }
+        uint64_t load() const {
+            uint64_t sum = 0;
+            for(const Stripe& stripe : stripes_) {
+                sum += stripe.cnt_.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+    };
+
+    const size_t SHARD_NUM;
+    Hash hasher_;
+    MySyncHashMap<KT, Entry*, Hash> index_;
+    std::unique_ptr<Shard[]> shards_;
+    StripedCounter hits_;
+    StripedCounter misses_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> expirations_;
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    Shard& shardOf(const KT& key) {
+        // the index uses the low bits of the same hash for its buckets, take the shard from the high bits
+        size_t hash = hasher_(key);
+        uint64_t mixed = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ULL;
+        return shards_[(mixed >> 32) % SHARD_NUM];
+    }
+
+    // the shard mutex must be held
+    static void linkBeforeHand(Shard& shard, Entry* entry) {
+        if(shard.hand_ == nullptr) {
+            shard.hand_ = entry;
+        } else {
+            // just behind the hand, the last place it reaches
+            entry->next_ = shard.hand_;
+            entry->prev_ = shard.hand_->prev_;
+            shard.hand_->prev_->next_ = entry;
+            shard.hand_->prev_ = entry;
+        }
+        ++shard.size_;
+    }
+
+    // the shard mutex must be held, the entry must already be out of the index
+    static void unlink(Shard& shard, Entry* entry) {
+        if(entry->next_ == entry) {
+            shard.hand_ = nullptr;
+        } else {
+            entry->prev_->next_ = entry->next_;
+            entry->next_->prev_ = entry->prev_;
+            if(shard.hand_ == entry) {
+                shard.hand_ = entry->next_;
+            }
+        }
+        --shard.size_;
+        EpochReclaimer::instance().retire(entry);
+    }
+
+    // the shard mutex must be held, advance the hand until an entry can go
+    void evictOne(Shard& shard) {
+        int64_t now = now_ns();
+        while(true) {
+            Entry* victim = shard.hand_;
+            bool expired = victim->expired(now);
+            if(expired || !victim->referenced_.exchange(false, std::memory_order_relaxed)) {
+                index_.eraseEntry(victim->key_);
+                unlink(shard, victim);
+                (expired ? expirations_ : evictions_).fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            shard.hand_ = victim->next_;
+        }
+    }
+
+public:
+    struct Stats {
+        uint64_t hits_;
+        uint64_t misses_;
+        uint64_t evictions_;
+        uint64_t expirations_;
+    };
+
+    // capacity is split evenly over the shards. Never more shards than capacity, a shard holds at least one entry and
+    // more shards would hold more than capacity together. A capacity of 0 is taken as 1
+    explicit MyConcurrentLRUCache(size_t capacity, size_t shard_num = 16, const Hash& hasher = Hash()):
+    SHARD_NUM(std::max<size_t>(std::min(shard_num, capacity), 1)), hasher_(hasher), index_(capacity, hasher),
+    shards_(new Shard[SHARD_NUM]), evictions_(0), expirations_(0) {
+        for(size_t i = 0; i < SHARD_NUM; ++i) {
+            shards_[i].capacity_ = std::max<size_t>(capacity / SHARD_NUM + (i < capacity % SHARD_NUM), 1);
+        }
+    }
+
+    ~MyConcurrentLRUCache() {
+        for(size_t i = 0; i < SHARD_NUM; ++i) {
+            Entry* hand = shards_[i].hand_;
+            if(hand == nullptr) {
+                continue;
+            }
+            hand->prev_->next_ = nullptr;
+            while(hand) {
+                Entry* next = hand->next_;
+                delete hand;
+                hand = next;
+            }
+        }
+    }
+
+    MyConcurrentLRUCache(const MyConcurrentLRUCache&) = delete;
+    MyConcurrentLRUCache& operator=(const MyConcurrentLRUCache&) = delete;
+
+    bool get(const KT& key, VT& placeholder) {
+        EpochReclaimer::Guard guard;
+        Entry* entry = nullptr;
+        if(!index_.getValue(key, entry)) {
+            misses_.add();
+            return false;
+        }
+        // no clock read for entries without a ttl
+        if(entry->expire_at_ != 0 && entry->expired(now_ns())) {
+            misses_.add();
+            Shard& shard = shardOf(key);
+            std::lock_guard<std::mutex> lock(shard.mtx_);
+            Entry* curr = nullptr;
+            // only drop it if nobody has replaced it meanwhile
+            if(index_.getValue(key, curr) && curr == entry) {
+                index_.eraseEntry(key);
+                unlink(shard, entry);
+                expirations_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return false;
+        }
+        // CRITICAL: test before set, an unconditional store would bounce the line of a hot entry between cores
+        if(!entry->referenced_.load(std::memory_order_relaxed)) {
+            entry->referenced_.store(true, std::memory_order_relaxed);
+        }
+        placeholder = entry->value_;
+        hits_.add();
+        return true;
+    }
+
+    // ttl of zero means the entry never expires
+    void put(const KT& key, VT value, std::chrono::nanoseconds ttl = std::chrono::nanoseconds::zero()) {
+        EpochReclaimer::Guard guard;
+        int64_t expire_at = ttl.count() > 0 ? now_ns() + ttl.count() : 0;
+        Entry* entry = new Entry(key, std::move(value), expire_at);
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx_);
+        Entry* old = nullptr;
+        if(index_.getValue(key, old)) {
+            // keep the recency of the key it replaces
+            entry->referenced_.store(old->referenced_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            index_.insertOrUpdate(key, entry);
+            linkBeforeHand(shard, entry);
+            unlink(shard, old);
+            return;
+        }
+        if(shard.size_ >= shard.capacity_) {
+            evictOne(shard);
+        }
+        index_.insertOrUpdate(key, entry);
+        linkBeforeHand(shard, entry);
+    }
+
+    bool erase(const KT& key) {
+        EpochReclaimer::Guard guard;
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx_);
+        Entry* entry = nullptr;
+        if(!index_.getValue(key, entry)) {
+            return false;
+        }
+        index_.eraseEntry(key);
+        unlink(shard, entry);
+        return true;
+    }
+
+    size_t size() const {
+        return index_.size();
+    }
+
+    Stats stats() const {
+        return Stats{hits_.load(), misses_.load(), evictions_.load(std::memory_order_relaxed),
+            expirations_.load(std::memory_order_relaxed)};
+    }
+};
+
+#endif //MY_CONCURRENT_LRU_CACHE_H
@@ -0,0 +1,429 @@
+//
+// Created by Charles Green on 10/26/25.
+//
+
+#ifndef MY_FROZEN_HASH_MAP_H
+#define MY_FROZEN_HASH_MAP_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * An immutable map built once from a list of entries, usually by MySyncHashMap::freeze(). Reads take no lock and
+ * never write anything, so any number of threads can share it.
+ *
+ * The entries sit in one flat array, placed by a minimal perfect hash in the hash-and-displace style (CHD / PTHash):
+ *  - every key is hashed once to 64 bits, which picks one of ~n/AVG_BUCKET_SIZE buckets;
+ *  - each bucket owns a seed, the position of a key is mix(hash ^ seed of its bucket) mapped onto [0, n / LOAD);
+ *  - at build time buckets are placed largest first, each tries seeds 0, 1, 2... until all of its keys land on
+ *    free positions. Big buckets go while the table is still empty, the many small ones fill the rest;
+ *  - the position space is a bit larger than n since filling the very last free places would cost ~n tries each.
+ *    The few keys that end up at a position >= n are remapped onto the holes left below n, so n keys still get
+ *    exactly n slots, no empty slot, no chain, no probing.
+ * A lookup reads the seed of its bucket and then the one slot, i.e. two cache misses (a third one for the ~3% of
+ * remapped keys), and compares the key stored there since a key that was never inserted also lands on some slot.
+ *
+ * For trivially copyable KT and VT the table can be written to a file with save() and opened again with load_mmap():
+ * the file is the in-memory layout, so loading is one mmap() and the pages fault in as lookups touch them. The Hash
+ * that reads a file must hash exactly like the one that wrote it.
+ */
+template <typename KT, typename VT, typename Hash=std::hash<KT>, typename KeyEqual=std::equal_to<KT>>
+class MyFrozenHashMap {
+    static constexpr size_t AVG_BUCKET_SIZE = 2;
+    static constexpr double LOAD = 0.97;
+    // a bucket needing more seeds than this has keys whose 64-bit hashes collide
+    static constexpr uint32_t MAX_SEED = 1u << 28;
+    static constexpr bool IS_TRANSPARENT = requires {
+        typename Hash::is_transparent;
+        typename KeyEqual::is_transparent;
+    };
+
+    struct Slot {
+        KT key_;
+        VT value_;
+    };
+
+    // start of a saved table, the arrays follow at the offsets computed by FileLayout
+    struct FileHeader {
+        char magic_[8];
+        uint64_t slot_size_;
+        uint64_t slot_num_;
+        uint64_t position_num_;
+        uint64_t bucket_num_;
+    };
+    static constexpr char MAGIC[8] = "MYFRZ01";
+
+    // position_num must not be below slot_num
+    struct FileLayout {
+        size_t seeds_offset_;
+        size_t remap_offset_;
+        size_t slots_offset_;
+        size_t file_size_;
+        // false if a size overflowed size_t, only the header of a corrupt file gets there
+        bool fits_ = true;
+        FileLayout(size_t slot_num, size_t position_num, size_t bucket_num) {
+            auto add = [this](size_t a, size_t b) {
+                size_t sum;
+                fits_ = !__builtin_add_overflow(a, b, &sum) && fits_;
+                return sum;
+            };
+            auto mul = [this](size_t a, size_t b) {
+                size_t product;
+                fits_ = !__builtin_mul_overflow(a, b, &product) && fits_;
+                return product;
+            };
+            auto align = [&add](size_t offset) { return add(offset, 63) / 64 * 64; };
+            seeds_offset_ = align(sizeof(FileHeader));
+            remap_offset_ = align(add(seeds_offset_, mul(bucket_num, sizeof(uint32_t))));
+            slots_offset_ = align(add(remap_offset_, mul(position_num - slot_num, sizeof(uint64_t))));
+            file_size_ = add(slots_offset_, mul(slot_num, sizeof(Slot)));
+        }
+    };
+
+    Hash hasher_;
+    KeyEqual equal_;
+    size_t slot_num_ = 0;
+    // size of the position space, slightly more than the number of slots
+    size_t position_num_ = 0;
+    size_t bucket_num_ = 0;
+    // point either into the vectors below or into a mapped file
+    const uint32_t* seeds_ = nullptr;
+    // slot of every position >= slot_num_
+    const uint64_t* remap_ = nullptr;
+    const Slot* slots_ = nullptr;
+    std::vector<uint32_t> own_seeds_;
+    std::vector<uint64_t> own_remap_;
+    std::vector<Slot> own_slots_;
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+
+    static uint64_t mix(uint64_t x) {
+        // murmur3 finalizer
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // map x onto [0, n) with a multiply instead of a division
+    static size_t reduce(uint64_t x, size_t n) {
+        return static_cast<size_t>((static_cast<unsigned __int128>(x) * n) >> 64);
+    }
+
+    template <typename K>
+    uint64_t hashOf(const K& key) const {
+        return mix(hasher_(key));
+    }
+
+    size_t bucketOf(uint64_t hash) const {
+        // 60% of the keys go to the first 30% of the buckets (PTHash's skew): the dense buckets are placed while the
+        // table is empty, the sparse ones are small enough to still find room when it is nearly full
+        size_t dense = bucket_num_ * 3 / 10;
+        constexpr uint64_t DENSE_SHARE = static_cast<uint64_t>(0.6 * 18446744073709551616.0);
+        if(hash < DENSE_SHARE) {
+            return reduce(hash * 0x9E3779B97F4A7C15ULL, dense);
+        }
+        return dense + reduce(hash * 0x9E3779B97F4A7C15ULL, bucket_num_ - dense);
+    }
+
+    size_t positionOf(uint64_t hash, uint32_t seed) const {
+        return reduce(mix(hash ^ (seed * 0x9E3779B97F4A7C15ULL)), position_num_);
+    }
+
+    template <typename K>
+    const Slot* find(const K& key) const {
+        if(slot_num_ == 0) {
+            return nullptr;
+        }
+        uint64_t hash = hashOf(key);
+        size_t pos = positionOf(hash, seeds_[bucketOf(hash)]);
+        const Slot& slot = slots_[pos < slot_num_ ? pos : remap_[pos - slot_num_]];
+        return equal_(slot.key_, key) ? &slot : nullptr;
+    }
+
+    template <typename K>
+    bool lookup(const K& key, VT& placeholder) const {
+        const Slot* slot = find(key);
+        if(slot == nullptr) {
+            return false;
+        }
+        placeholder = slot->value_;
+        return true;
+    }
+
+    void build(std::vector<std::pair<KT, VT>>&& entries) {
+        size_t n = entries.size();
+        if(n == 0) {
+            return;
+        }
+        slot_num_ = n;
+        position_num_ = std::max(static_cast<size_t>(n / LOAD), n);
+        bucket_num_ = (n + AVG_BUCKET_SIZE - 1) / AVG_BUCKET_SIZE;
+        own_seeds_.assign(bucket_num_, 0);
+        size_t bucket_num = bucket_num_;
+
+        std::vector<uint64_t> hashes(n);
+        std::vector<uint32_t> bucket_size(bucket_num, 0);
+        for(size_t i = 0; i < n; ++i) {
+            hashes[i] = hashOf(entries[i].first);
+            ++bucket_size[bucketOf(hashes[i])];
+        }
+        // buckets largest first with a counting sort on size
+        size_t max_bucket_size = *std::max_element(bucket_size.begin(), bucket_size.end());
+        std::vector<size_t> size_begin(max_bucket_size + 2, 0);
+        for(uint32_t size : bucket_size) {
+            ++size_begin[max_bucket_size - size + 1];
+        }
+        for(size_t i = 1; i < size_begin.size(); ++i) {
+            size_begin[i] += size_begin[i - 1];
+        }
+        std::vector<size_t> order(bucket_num);
+        for(size_t b = 0; b < bucket_num; ++b) {
+            order[size_begin[max_bucket_size - bucket_size[b]]++] = b;
+        }
+        // entry indices and their hashes laid out bucket after bucket in placement order, so the placement loop below
+        // runs over both arrays sequentially instead of jumping to a random bucket each time
+        std::vector<size_t> member_begin(bucket_num);
+        for(size_t j = 0, offset = 0; j < bucket_num; ++j) {
+            member_begin[order[j]] = offset;
+            offset += bucket_size[order[j]];
+        }
+        std::vector<size_t> members(n);
+        std::vector<uint64_t> member_hashes(n);
+        for(size_t i = 0; i < n; ++i) {
+            size_t k = member_begin[bucketOf(hashes[i])]++;
+            members[k] = i;
+            member_hashes[k] = hashes[i];
+        }
+        hashes = std::vector<uint64_t>();
+        member_begin = std::vector<size_t>();
+
+        std::vector<bool> taken(position_num_, false);
+        // entry index of every taken position
+        std::vector<size_t> placed(position_num_);
+        std::vector<size_t> tried;
+        size_t begin = 0;
+        for(size_t b : order) {
+            size_t end = begin + bucket_size[b];
+            for(uint32_t seed = 0;; ++seed) {
+                if(seed == MAX_SEED) {
+                    throw std::runtime_error("MyFrozenHashMap: keys with identical hashes");
+                }
+                tried.clear();
+                bool fits = true;
+                for(size_t k = begin; k < end && fits; ++k) {
+                    size_t pos = positionOf(member_hashes[k], seed);
+                    fits = !taken[pos] && std::find(tried.begin(), tried.end(), pos) == tried.end();
+                    tried.push_back(pos);
+                }
+                if(fits) {
+                    for(size_t k = begin; k < end; ++k) {
+                        taken[tried[k - begin]] = true;
+                        placed[tried[k - begin]] = members[k];
+                    }
+                    own_seeds_[b] = seed;
+                    break;
+                }
+            }
+            begin = end;
+        }
+        // move the entries beyond n into the holes below n, in order
+        own_remap_.assign(position_num_ - n, 0);
+        size_t hole = 0;
+        for(size_t pos = n; pos < position_num_; ++pos) {
+            if(taken[pos]) {
+                while(taken[hole]) {
+                    ++hole;
+                }
+                taken[hole] = true;
+                placed[hole] = placed[pos];
+                own_remap_[pos - n] = hole;
+            }
+        }
+        own_slots_.reserve(n);
+        for(size_t slot = 0; slot < n; ++slot) {
+            own_slots_.push_back(Slot{std::move(entries[placed[slot]].first), std::move(entries[placed[slot]].second)});
+        }
+        seeds_ = own_seeds_.data();
+        remap_ = own_remap_.data();
+        slots_ = own_slots_.data();
+    }
+
+    // serve a table from a mapping load_mmap() has validated
+    MyFrozenHashMap(void* mapping, size_t mapping_size, const Hash& hasher, const KeyEqual& equal):
+    hasher_(hasher), equal_(equal), mapping_(mapping), mapping_size_(mapping_size) {
+        const char* base = static_cast<const char*>(mapping);
+        const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+        slot_num_ = header->slot_num_;
+        position_num_ = header->position_num_;
+        bucket_num_ = header->bucket_num_;
+        FileLayout layout(slot_num_, position_num_, bucket_num_);
+        seeds_ = reinterpret_cast<const uint32_t*>(base + layout.seeds_offset_);
+        remap_ = reinterpret_cast<const uint64_t*>(base + layout.remap_offset_);
+        slots_ = reinterpret_cast<const Slot*>(base + layout.slots_offset_);
+    }
+
+public:
+    // entries must not repeat a key
+    explicit MyFrozenHashMap(std::vector<std::pair<KT, VT>> entries, const Hash& hasher = Hash(),
+        const KeyEqual& equal = KeyEqual()): hasher_(hasher), equal_(equal) {
+        build(std::move(entries));
+    }
+
+    MyFrozenHashMap(MyFrozenHashMap&& other) noexcept: hasher_(std::move(other.hasher_)),
+    equal_(std::move(other.equal_)), slot_num_(other.slot_num_), position_num_(other.position_num_),
+    bucket_num_(other.bucket_num_), seeds_(other.seeds_), remap_(other.remap_), slots_(other.slots_),
+    own_seeds_(std::move(other.own_seeds_)), own_remap_(std::move(other.own_remap_)),
+    own_slots_(std::move(other.own_slots_)), mapping_(other.mapping_), mapping_size_(other.mapping_size_) {
+        // moving a vector keeps its buffer, so the pointers stay valid
+        other.slot_num_ = 0;
+        other.mapping_ = nullptr;
+    }
+
+    MyFrozenHashMap(const MyFrozenHashMap&) = delete;
+    MyFrozenHashMap& operator=(const MyFrozenHashMap&) = delete;
+    MyFrozenHashMap& operator=(MyFrozenHashMap&&) = delete;
+
+    ~MyFrozenHashMap() {
+        if(mapping_) {
+            munmap(mapping_, mapping_size_);
+        }
+    }
+
+    // write the table to path, throw std::runtime_error on failure
+    void save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable_v<KT> && std::is_trivially_copyable_v<VT>,
+            "only tables of trivially copyable keys and values can be saved");
+        FileLayout layout(slot_num_, position_num_, bucket_num_);
+        FileHeader header{};
+        std::memcpy(header.magic_, MAGIC, sizeof(MAGIC));
+        header.slot_size_ = sizeof(Slot);
+        header.slot_num_ = slot_num_;
+        header.position_num_ = position_num_;
+        header.bucket_num_ = bucket_num_;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        size_t written = 0;
+        // zero padding up to offset, then len bytes of data
+        auto write_at = [&out, &written](size_t offset, const void* data, size_t len) {
+            static const char zeros[64] = {};
+            out.write(zeros, static_cast<std::streamsize>(offset - written));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(len));
+            written = offset + len;
+        };
+        write_at(0, &header, sizeof(header));
+        write_at(layout.seeds_offset_, seeds_, bucket_num_ * sizeof(uint32_t));
+        write_at(layout.remap_offset_, remap_, (position_num_ - slot_num_) * sizeof(uint64_t));
+        // field by field into zeroed slots, the padding of Slot would otherwise carry whatever was in memory into the
+        // file. A chunk at a time, so saving does not need a second copy of the table
+        constexpr size_t CHUNK = 4096;
+        std::vector<char> chunk(CHUNK * sizeof(Slot));
+        for(size_t first = 0; first < slot_num_; first += CHUNK) {
+            size_t num = std::min(CHUNK, slot_num_ - first);
+            std::fill(chunk.begin(), chunk.end(), 0);
+            for(size_t i = 0; i < num; ++i) {
+                char* slot = chunk.data() + i * sizeof(Slot);
+                std::memcpy(slot + offsetof(Slot, key_), &slots_[first + i].key_, sizeof(KT));
+                std::memcpy(slot + offsetof(Slot, value_), &slots_[first + i].value_, sizeof(VT));
+            }
+            write_at(layout.slots_offset_ + first * sizeof(Slot), chunk.data(), num * sizeof(Slot));
+        }
+        out.flush();
+        if(!out) {
+            throw std::runtime_error("MyFrozenHashMap: cannot write " + path);
+        }
+    }
+
+    /**
+     * Open a table written by save(). The file is mapped read-only and served in place. Only the header and the remap
+     * array (the few percent of positions beyond the slots) are read up front, so this takes little more than one
+     * mmap() whatever the size. Throw std::runtime_error if path cannot be mapped or does not hold a table of this
+     * KT / VT: a header whose sizes do not add up to the file, or a remap entry pointing outside the slots, would
+     * send find() out of the mapping.
+     */
+    static MyFrozenHashMap load_mmap(const std::string& path, const Hash& hasher = Hash(),
+        const KeyEqual& equal = KeyEqual()) {
+        static_assert(std::is_trivially_copyable_v<KT> && std::is_trivially_copyable_v<VT>,
+            "only tables of trivially copyable keys and values can be loaded");
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw std::runtime_error("MyFrozenHashMap: cannot open " + path);
+        }
+        struct stat st{};
+        void* mapping = MAP_FAILED;
+        if(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FileHeader)) {
+            mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        // the mapping keeps the file alive
+        close(fd);
+        if(mapping == MAP_FAILED) {
+            throw std::runtime_error("MyFrozenHashMap: cannot map " + path);
+        }
+        size_t size = st.st_size;
+        const FileHeader* header = static_cast<const FileHeader*>(mapping);
+        const size_t slot_num = header->slot_num_;
+        const size_t position_num = header->position_num_;
+        // a key needs a bucket for its seed
+        bool valid = std::memcmp(header->magic_, MAGIC, sizeof(MAGIC)) == 0 && header->slot_size_ == sizeof(Slot) &&
+            position_num >= slot_num && (slot_num == 0 || header->bucket_num_ > 0);
+        if(valid) {
+            FileLayout layout(slot_num, position_num, header->bucket_num_);
+            valid = layout.fits_ && layout.file_size_ == size;
+            const uint64_t* remap = reinterpret_cast<const uint64_t*>(static_cast<const char*>(mapping) +
+                layout.remap_offset_);
+            for(size_t i = 0; valid && i < position_num - slot_num; ++i) {
+                valid = remap[i] < slot_num;
+            }
+        }
+        if(!valid) {
+            munmap(mapping, size);
+            throw std::runtime_error("MyFrozenHashMap: " + path + " is not a table of this type");
+        }
+        return MyFrozenHashMap(mapping, size, hasher, equal);
+    }
+
+    // call func(const KT&, const VT&) for every entry, in slot order
+    template <typename Func>
+    void for_each(Func func) const {
+        for(size_t i = 0; i < slot_num_; ++i) {
+            func(slots_[i].key_, slots_[i].value_);
+        }
+    }
+
+    bool getValue(const KT& key, VT& placeholder) const {
+        return lookup(key, placeholder);
+    }
+
+    template <typename K> requires IS_TRANSPARENT
+    bool getValue(const K& key, VT& placeholder) const {
+        return lookup(key, placeholder);
+    }
+
+    bool contains(const KT& key) const {
+        return find(key) != nullptr;
+    }
+
+    template <typename K> requires IS_TRANSPARENT
+    bool contains(const K& key) const {
+        return find(key) != nullptr;
+    }
+
+    size_t size() const {
+        return slot_num_;
+    }
+};
+
+#endif //MY_FROZEN_HASH_MAP_H
@@ -0,0 +1,315 @@
+//
+// Created by Charles Green on 10/18/25.
+//
+
+#ifndef MY_SYNC_FLAT_HASH_MAP_H
+#define MY_SYNC_FLAT_HASH_MAP_H
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <shared_mutex>
+#include <mutex>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * A drop-in alternative to MySyncHashMap (same getValue / insertOrUpdate / eraseEntry) built for lookups.
+ *
+ * MySyncHashMap chases one pointer per chained node before it reaches a value. Here the map is split into STRIPE_NUM
+ * independent Swiss tables, each guarded by its own shared_mutex so readers of a stripe run in parallel and only
+ * writers are exclusive:
+ *  - keys and values live inline in one slot array, a hit touches one control group and one slot;
+ *  - a control byte per slot holds 7 bits of the hash (full), EMPTY or DELETED;
+ *  - a probe loads a 16-byte control group at once and compares all of it with the 7 bits in a couple of SSE2
+ *    instructions, only candidates whose control byte matches are compared by key;
+ *  - probing stops at the first group with an EMPTY byte, so a miss usually costs one group.
+ */
+template <typename KT, typename VT, typename Hash=std::hash<KT>>
+class MySyncFlatHashMap {
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr size_t STRIPE_NUM = 64;
+    static constexpr size_t STRIPE_BITS = 6;
+    static constexpr int8_t EMPTY = -128;   // 0b10000000
+    static constexpr int8_t DELETED = -2;   // 0b11111110
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+    // bit i set <=> byte i of the group satisfied the test
+    class BitMask {
+        uint32_t mask_;
+    public:
+        explicit BitMask(uint32_t mask): mask_(mask) {}
+        explicit operator bool() const {
+            return mask_ != 0;
+        }
+        size_t lowest() const {
+            return __builtin_ctz(mask_);
+        }
+        void clear_lowest() {
+            mask_ &= mask_ - 1;
+        }
+    };
+
+    class Group {
+#ifdef __SSE2__
+        __m128i ctrl_;
+    public:
+        explicit Group(const int8_t* pos): ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+        BitMask match(int8_t h2) const {
+            return BitMask(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+        }
+        BitMask match_empty() const {
+            return match(EMPTY);
+        }
+        // EMPTY and DELETED are the only negative control bytes
+        BitMask match_empty_or_deleted() const {
+            return BitMask(_mm_movemask_epi8(ctrl_));
+        }
+#else
+        // portable fallback, e.g. for arm64
+        int8_t ctrl_[GROUP_WIDTH];
+    public:
+        explicit Group(const int8_t* pos) {
+            std::memcpy(ctrl_, pos, GROUP_WIDTH);
+        }
+        BitMask match(int8_t h2) const {
+            uint32_t mask = 0;
+            for(size_t i = 0; i < GROUP_WIDTH; ++i) {
+                mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+            }
+            return BitMask(mask);
+        }
+        BitMask match_empty() const {
+            return match(EMPTY);
+        }
+        BitMask match_empty_or_deleted() const {
+            uint32_t mask = 0;
+            for(size_t i = 0; i < GROUP_WIDTH; ++i) {
+                mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+            }
+            return BitMask(mask);
+        }
+#endif
+    };
+
+    struct Slot {
+        KT key_;
+        VT value_;
+        template <typename KK, typename VV>
+        Slot(KK&& key, VV&& value): key_(std::forward<KK>(key)), value_(std::forward<VV>(value)) {}
+    };
+
+    // one open addressing table, capacity is a power of two multiple of GROUP_WIDTH
+    struct alignas(64) Stripe {
+        std::shared_mutex mtx_;
+        std::unique_ptr<int8_t[]> ctrl_;
+        Slot* slots_ = nullptr;
+        size_t capacity_ = 0;
+        size_t size_ = 0;
+        size_t deleted_ = 0;
+
+        Stripe() = default;
+        Stripe(const Stripe&) = delete;
+        Stripe& operator=(const Stripe&) = delete;
+        ~Stripe() {
+            destroy_slots(ctrl_.get(), slots_, capacity_);
+        }
+
+        static void destroy_slots(int8_t* ctrl, Slot* slots, size_t capacity) {
+            for(size_t i = 0; i < capacity; ++i) {
+                if(ctrl[i] >= 0) {
+                    slots[i].~Slot();
+                }
+            }
+            ::operator delete(slots, std::align_val_t(alignof(Slot)));
+        }
+
+        size_t group_num() const {
+            return capacity_ / GROUP_WIDTH;
+        }
+
+        // triangular probing over groups visits every group once when group_num is a power of two
+        // index of the slot holding key, or NPOS
+        template <typename Key>
+        size_t find(const Key& key, size_t h1, int8_t h2) const {
+            size_t mask = group_num() - 1;
+            size_t group = h1 & mask;
+            for(size_t i = 1; i <= group_num(); ++i) {
+                size_t base = group * GROUP_WIDTH;
+                Group g(ctrl_.get() + base);
+                for(BitMask m = g.match(h2); m; m.clear_lowest()) {
+                    size_t candidate = base + m.lowest();
+                    if(slots_[candidate].key_ == key) {
+                        return candidate;
+                    }
+                }
+                if(g.match_empty()) {
+                    return NPOS;
+                }
+                group = (group + i) & mask;
+            }
+            return NPOS;
+        }
+
+        // first EMPTY or DELETED slot along the same probe sequence, there must be one
+        size_t find_free(size_t h1) const {
+            size_t mask = group_num() - 1;
+            size_t group = h1 & mask;
+            for(size_t i = 1; ; ++i) {
+                BitMask m = Group(ctrl_.get() + group * GROUP_WIDTH).match_empty_or_deleted();
+                if(m) {
+                    return group * GROUP_WIDTH + m.lowest();
+                }
+                group = (group + i) & mask;
+            }
+        }
+
+        template <typename HashOf>
+        void rehash(size_t new_capacity, HashOf hash_of) {
+            std::unique_ptr<int8_t[]> old_ctrl = std::move(ctrl_);
+            Slot* old_slots = slots_;
+            size_t old_capacity = capacity_;
+
+            ctrl_ = std::make_unique<int8_t[]>(new_capacity);
+            std::memset(ctrl_.get(), EMPTY, new_capacity);
+            slots_ = static_cast<Slot*>(::operator new(sizeof(Slot) * new_capacity, std::align_val_t(alignof(Slot))));
+            capacity_ = new_capacity;
+            deleted_ = 0;
+            for(size_t i = 0; i < old_capacity; ++i) {
+                if(old_ctrl[i] >= 0) {
+                    size_t hash = hash_of(old_slots[i].key_);
+                    size_t idx = find_free(h1_of(hash));
+                    new (&slots_[idx]) Slot(std::move(old_slots[i].key_), std::move(old_slots[i].value_));
+                    ctrl_[idx] = h2_of(hash);
+                }
+            }
+            if(old_ctrl) {
+                destroy_slots(old_ctrl.get(), old_slots, old_capacity);
+            }
+        }
+    };
+
+    // std::hash of integers is the identity, mix it so stripe, group and control bits are all well distributed
+    static size_t mix(size_t h) {
+        uint64_t x = h;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+    static size_t stripe_of(size_t hash) {
+        return hash & (STRIPE_NUM - 1);
+    }
+    static int8_t h2_of(size_t hash) {
+        return static_cast<int8_t>((hash >> STRIPE_BITS) & 0x7F);
+    }
+    static size_t h1_of(size_t hash) {
+        return hash >> (STRIPE_BITS + 7);
+    }
+
+    Hash hasher_;
+    std::unique_ptr<Stripe[]> stripes_;
+
+    size_t hash_of(const KT& key) const {
+        return mix(hasher_(key));
+    }
+
+public:
+    MySyncFlatHashMap(size_t expected_size = 0, const Hash& hasher = Hash()): hasher_(hasher),
+    stripes_(new Stripe[STRIPE_NUM]) {
+        size_t per_stripe = expected_size / STRIPE_NUM;
+        if(per_stripe > 0) {
+            // keep the load factor under 7/8 without growing
+            size_t capacity = GROUP_WIDTH;
+            while(capacity * 7 / 8 < per_stripe) {
+                capacity *= 2;
+            }
+            auto hash_of_key = [this](const KT& key) { return hash_of(key); };
+            for(size_t i = 0; i < STRIPE_NUM; ++i) {
+                stripes_[i].rehash(capacity, hash_of_key);
+            }
+        }
+    }
+    MySyncFlatHashMap(const MySyncFlatHashMap&) = delete;
+    MySyncFlatHashMap& operator=(const MySyncFlatHashMap&) = delete;
+
+    bool getValue(const KT& key, VT& placeholder) {
+        size_t hash = hash_of(key);
+        Stripe& stripe = stripes_[stripe_of(hash)];
+        std::shared_lock<std::shared_mutex> lock(stripe.mtx_);
+        size_t idx = stripe.find(key, h1_of(hash), h2_of(hash));
+        if(idx == NPOS) {
+            return false;
+        }
+        placeholder = stripe.slots_[idx].value_;
+        return true;
+    }
+
+    // return true for insert and false for update
+    template<typename KK, typename VV>
+    bool insertOrUpdate(KK&& key, VV&& value) {
+        size_t hash = hash_of(key);
+        Stripe& stripe = stripes_[stripe_of(hash)];
+        std::unique_lock<std::shared_mutex> lock(stripe.mtx_);
+        size_t idx = stripe.find(key, h1_of(hash), h2_of(hash));
+        if(idx != NPOS) {
+            stripe.slots_[idx].value_ = std::forward<VV>(value);
+            return false;
+        }
+        // grow at 7/8 load, tombstones count as load as well since they lengthen probes
+        if((stripe.size_ + stripe.deleted_ + 1) * 8 > stripe.capacity_ * 7) {
+            size_t new_capacity = stripe.capacity_ == 0 ? GROUP_WIDTH : stripe.capacity_;
+            // only double if live elements need it, otherwise rehashing in place just drops the tombstones
+            if((stripe.size_ + 1) * 16 > new_capacity * 7) {
+                new_capacity *= 2;
+            }
+            stripe.rehash(new_capacity, [this](const KT& k) { return hash_of(k); });
+        }
+        idx = stripe.find_free(h1_of(hash));
+        if(stripe.ctrl_[idx] == DELETED) {
+            --stripe.deleted_;
+        }
+        new (&stripe.slots_[idx]) Slot(std::forward<KK>(key), std::forward<VV>(value));
+        stripe.ctrl_[idx] = h2_of(hash);
+        ++stripe.size_;
+        return true;
+    }
+
+    // true if key exists
+    bool eraseEntry(const KT& key) {
+        size_t hash = hash_of(key);
+        Stripe& stripe = stripes_[stripe_of(hash)];
+        std::unique_lock<std::shared_mutex> lock(stripe.mtx_);
+        size_t idx = stripe.find(key, h1_of(hash), h2_of(hash));
+        if(idx == NPOS) {
+            return false;
+        }
+        stripe.slots_[idx].~Slot();
+        --stripe.size_;
+        // a probe never walks past a group that still has an EMPTY byte, so no tombstone is needed there
+        size_t base = idx / GROUP_WIDTH * GROUP_WIDTH;
+        if(Group(stripe.ctrl_.get() + base).match_empty()) {
+            stripe.ctrl_[idx] = EMPTY;
+        } else {
+            stripe.ctrl_[idx] = DELETED;
+            ++stripe.deleted_;
+        }
+        return true;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for(size_t i = 0; i < STRIPE_NUM; ++i) {
+            std::shared_lock<std::shared_mutex> lock(stripes_[i].mtx_);
+            total += stripes_[i].size_;
+        }
+        return total;
+    }
+};
+
+#endif //MY_SYNC_FLAT_HASH_MAP_H
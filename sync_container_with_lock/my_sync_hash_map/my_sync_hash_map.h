@@ -7,39 +7,587 @@
 #include <vector>
 #include <list>
 #include <algorithm>
-#include "../my_sync_forward_list/my_sync_forward_list.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include "my_frozen_hash_map.h"
+#include "../../my_utility/my_epoch_reclaimer.h"
 
 
 
 
 // a sync map should not expose reference to a value
-template <typename KT, typename VT, typename Hash=std::hash<KT>>
+/**
+ * Each bucket is a singly linked chain with one writer mutex and a sequence counter (seqlock):
+ *  - writers lock the bucket, make the counter odd, modify the chain, make it even again;
+ *  - getValue takes no lock at all: it reads the counter, walks the chain, copies the value and re-reads the counter,
+ *    retrying if a writer was active in between. After MAX_OPTIMISTIC_TRIES failures it falls back to the mutex;
+ *  - nodes are never freed while a reader may stand on them: unlinked nodes go through EpochReclaimer, every
+ *    operation runs inside an epoch guard.
+ * If VT is trivially copyable an update overwrites the value in place (a torn copy is caught by the counter check),
+ * otherwise the node is replaced by a fresh one so a reader never copies an object that is being modified.
+ *
+ * The bucket array grows by doubling once size / bucket count exceeds max_load_factor, without a stop-the-world
+ * rehash:
+ *  - the new table is hung on the old one (Table::next_), the old one stays current until every bucket is moved;
+ *  - each writing operation moves MIGRATE_STEP old buckets before returning. Since the new size is twice the old one,
+ *    old bucket i splits into new buckets i and i + old size only, so migrations of different buckets never collide;
+ *  - a bucket is migrated under its own mutex and flagged afterwards, operations that see the flag follow next_;
+ *  - a fully migrated table is retired through EpochReclaimer as well.
+ *
+ * If both Hash and KeyEqual declare is_transparent, getValue / contains / compute_if_present / eraseEntry also
+ * accept any key type they can hash and compare with KT, e.g. a string_view or const char* into a map keyed by
+ * std::string (see MyTransparentStringHash), without building a temporary KT.
+ *
+ * save() writes the content as a MyFrozenHashMap file. load_mmap() attaches such a file to an empty map as a read-only
+ * base layer: lookups that miss the live chains fall through to the mapped table, writes always go to the chains.
+ * A key erased while it is still visible in the base is kept in its chain as a tombstone node that hides it. The base
+ * can be copied into the chains by a background thread, after which it is detached and unmapped.
+ */
+template <typename KT, typename VT, typename Hash=std::hash<KT>, typename KeyEqual=std::equal_to<KT>>
 class MySyncHashMap {
-    struct KVPair  {
-        KT key_;
-        std::unique_ptr<VT> value_;
-        KVPair() = default;
+    static constexpr bool INPLACE_UPDATE = std::is_trivially_copyable_v<VT>;
+    static constexpr bool IS_TRANSPARENT = requires {
+        typename Hash::is_transparent;
+        typename KeyEqual::is_transparent;
+    };
+    static constexpr int MAX_OPTIMISTIC_TRIES = 8;
+
+    struct ListNode {
+        const KT key_;
+        VT value_;
+        std::atomic<ListNode*> next_;
+        // the key is erased, but the base layer may still hold it
+        const bool tombstone_;
         template <typename KK, typename VV>
-        KVPair(KK&& key, VV&& value): key_(std::forward<KK>(key)), value_(std::make_unique<VT>(std::forward<VV>(value))) {}
-        KVPair(const KVPair&) = delete;
-        KVPair(KVPair&&) = default;
-        KVPair& operator=(const KVPair&) = delete;
-        KVPair& operator=(KVPair&&) noexcept = default;
+        ListNode(KK&& key, VV&& value): key_(std::forward<KK>(key)), value_(std::forward<VV>(value)), next_(nullptr),
+        tombstone_(false) {}
+        struct TombstoneTag {};
+        template <typename KK>
+        ListNode(TombstoneTag, KK&& key): key_(std::forward<KK>(key)), value_(), next_(nullptr), tombstone_(true) {}
+    };
+
+    using Frozen = MyFrozenHashMap<KT, VT, Hash, KeyEqual>;
+
+    // retired together with a detached base, so tombstones stop being made only once no reader can still see it
+    struct TombstoneSwitch {
+        std::shared_ptr<std::atomic<bool>> keep_tombstones_;
+        ~TombstoneSwitch() {
+            keep_tombstones_->store(false, std::memory_order_release);
+        }
+    };
+
+    enum class Probe { ABSENT, PRESENT, ERASED };
+
+    struct alignas(64) Bucket {
+        std::mutex mtx_;
+        // odd while a writer is modifying the chain
+        std::atomic<uint64_t> version_;
+        std::atomic<ListNode*> head_;
+        // set once the elements have moved to the next table
+        std::atomic<bool> migrated_;
+        Bucket(): version_(0), head_(nullptr), migrated_(false) {}
+        ~Bucket() {
+            ListNode* curr = head_.load(std::memory_order_relaxed);
+            while(curr) {
+                ListNode* next = curr->next_.load(std::memory_order_relaxed);
+                delete curr;
+                curr = next;
+            }
+        }
+        // writer side of the seqlock, the bucket mutex must be held
+        void begin_write() {
+            version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        void end_write() {
+            version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+    struct Table {
+        const size_t SIZE_;
+        std::unique_ptr<Bucket[]> buckets_;
+        // non-null while this table is being migrated into a bigger one
+        std::atomic<Table*> next_;
+        // next old bucket to hand out to a migrating thread
+        std::atomic<size_t> migrate_cursor_;
+        std::atomic<size_t> migrated_cnt_;
+        Table(size_t size): SIZE_(size), buckets_(new Bucket[size]), next_(nullptr), migrate_cursor_(0),
+        migrated_cnt_(0) {}
     };
 
+    // how many old buckets every writing operation moves while a resize is in progress
+    static constexpr size_t MIGRATE_STEP = 2;
 
-    std::vector<std::unique_ptr<MySyncForwardList<KVPair>>> buckets_;
-    const int BUCKET_NUM;
+    const double MAX_LOAD_FACTOR_;
     Hash hasher_;
-    MySyncForwardList<KVPair>& getBucket(const KT& key) {
-        size_t idx = hasher_(key) % buckets_.size();
-        return *buckets_[idx];
+    KeyEqual equal_;
+    std::atomic<Table*> table_;
+    std::atomic<long> count_;
+    // read-only layer under the chains, set by load_mmap()
+    std::atomic<Frozen*> base_;
+    std::shared_ptr<std::atomic<bool>> keep_tombstones_;
+    std::atomic<bool> stop_promotion_;
+    std::thread promoter_;
+
+    // run func on the bucket currently responsible for hash, with the bucket mutex held
+    template <typename Func>
+    auto withLockedBucket(size_t hash, Func func) {
+        Table* table = table_.load(std::memory_order_acquire);
+        while(true) {
+            Bucket& bkt = table->buckets_[hash % table->SIZE_];
+            std::lock_guard<std::mutex> lock(bkt.mtx_);
+            if(!bkt.migrated_.load(std::memory_order_relaxed)) {
+                return func(bkt);
+            }
+            // the bucket has moved, and a migrated bucket implies next_ is set
+            table = table->next_.load(std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * Run read on bkt as a seqlock reader: read may be called several times and must redo all of its work on each
+     * call, its results are only meaningful if this returns true. After MAX_OPTIMISTIC_TRIES torn attempts read runs
+     * once more with the bucket mutex held. False means the bucket has moved to the next table.
+     */
+    template <typename Read>
+    bool readBucket(Bucket& bkt, Read read) {
+        for(int tries = 0; tries < MAX_OPTIMISTIC_TRIES; ++tries) {
+            uint64_t before = bkt.version_.load(std::memory_order_acquire);
+            if(before & 1) {
+                // a writer is in the middle of it
+                std::this_thread::yield();
+                continue;
+            }
+            if(bkt.migrated_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            read(bkt);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(bkt.version_.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        // too much write traffic on this bucket, queue up behind the writers
+        std::lock_guard<std::mutex> lock(bkt.mtx_);
+        if(bkt.migrated_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        read(bkt);
+        return true;
+    }
+
+    // the chain may change under our feet unless the mutex is held
+    template <typename K>
+    ListNode* find(const Bucket& bkt, const K& key) const {
+        for(ListNode* curr = bkt.head_.load(std::memory_order_acquire); curr;
+            curr = curr->next_.load(std::memory_order_acquire)) {
+            if(equal_(curr->key_, key)) {
+                return curr;
+            }
+        }
+        return nullptr;
+    }
+
+    // the bucket mutex must be held, return the node of key (or null) and its predecessor in prev
+    template <typename K>
+    ListNode* findLocked(Bucket& bkt, const K& key, ListNode*& prev) const {
+        prev = nullptr;
+        ListNode* curr = bkt.head_.load(std::memory_order_relaxed);
+        while(curr && !equal_(curr->key_, key)) {
+            prev = curr;
+            curr = curr->next_.load(std::memory_order_relaxed);
+        }
+        return curr;
+    }
+
+    // put new_node where curr is, curr stays readable for whoever is standing on it
+    static void replaceLocked(Bucket& bkt, ListNode* prev, ListNode* curr, ListNode* new_node) {
+        new_node->next_.store(curr->next_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        bkt.begin_write();
+        (prev ? prev->next_ : bkt.head_).store(new_node, std::memory_order_release);
+        bkt.end_write();
+        EpochReclaimer::instance().retire(curr);
+    }
+
+    static void pushFrontLocked(Bucket& bkt, ListNode* new_node) {
+        new_node->next_.store(bkt.head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        bkt.begin_write();
+        bkt.head_.store(new_node, std::memory_order_release);
+        bkt.end_write();
     }
+
+    /**
+     * Run func on the value of curr, the bucket mutex must be held. A trivially copyable value is modified in place
+     * inside a write section. Anything else is modified on a copy which then replaces curr, because an optimistic
+     * reader may be copying the old value at this very moment.
+     */
+    template <typename Func>
+    static void modifyLocked(Bucket& bkt, ListNode* prev, ListNode* curr, Func& func) {
+        if constexpr (INPLACE_UPDATE) {
+            bkt.begin_write();
+            func(curr->value_);
+            bkt.end_write();
+        } else {
+            ListNode* new_node = new ListNode(curr->key_, curr->value_);
+            func(new_node->value_);
+            replaceLocked(bkt, prev, curr, new_node);
+        }
+    }
+
+    // the bucket mutex must be held, return true for insert and false for update
+    template<typename KK, typename VV>
+    bool insertOrUpdateLocked(Bucket& bkt, KK&& key, VV&& value) {
+        ListNode* prev;
+        ListNode* curr = findLocked(bkt, key, prev);
+        if(curr == nullptr) {
+            Frozen* base = base_.load(std::memory_order_acquire);
+            bool in_base = base && base->contains(key);
+            // allocate before the version goes odd, readers should not wait for the allocator
+            pushFrontLocked(bkt, new ListNode(std::forward<KK>(key), std::forward<VV>(value)));
+            return !in_base;
+        }
+        if(curr->tombstone_) {
+            replaceLocked(bkt, prev, curr, new ListNode(curr->key_, std::forward<VV>(value)));
+            return true;
+        }
+        if constexpr (INPLACE_UPDATE) {
+            bkt.begin_write();
+            curr->value_ = std::forward<VV>(value);
+            bkt.end_write();
+        } else {
+            replaceLocked(bkt, prev, curr, new ListNode(curr->key_, std::forward<VV>(value)));
+        }
+        return false;
+    }
+
+    // indices of keys ordered by their bucket in table, so each bucket is visited once
+    template <typename GetKey>
+    std::vector<std::pair<size_t, size_t>> groupByBucket(const Table* table, size_t n, GetKey get_key) {
+        std::vector<std::pair<size_t, size_t>> order;
+        order.reserve(n);
+        for(size_t i = 0; i < n; ++i) {
+            order.emplace_back(hasher_(get_key(i)) % table->SIZE_, i);
+        }
+        // ties are broken by index, keys of one bucket keep their original order
+        std::sort(order.begin(), order.end());
+        return order;
+    }
+
+    /**
+     * Software pipeline over the sorted batch: when entry pos is about to be processed, the bucket PREFETCH_DISTANCE
+     * entries ahead is requested, and the first node of the bucket half as far ahead, whose head_ should have
+     * arrived by now. Several misses are in flight at any time instead of one after another.
+     */
+    static constexpr size_t PREFETCH_DISTANCE = 16;
+    static void prefetchAhead(const Table* table, const std::vector<std::pair<size_t, size_t>>& order, size_t pos) {
+        if(pos + PREFETCH_DISTANCE < order.size()) {
+            __builtin_prefetch(&table->buckets_[order[pos + PREFETCH_DISTANCE].first]);
+        }
+        if(pos + PREFETCH_DISTANCE / 2 < order.size()) {
+            __builtin_prefetch(table->buckets_[order[pos + PREFETCH_DISTANCE / 2].first].head_.load(
+                std::memory_order_relaxed));
+        }
+    }
+
+    void migrateBucket(Table* table, Table* next, size_t idx) {
+        Bucket& bkt = table->buckets_[idx];
+        std::lock_guard<std::mutex> lock(bkt.mtx_);
+        // nobody writes next->buckets_[idx] or next->buckets_[idx + table->SIZE_] until migrated_ is set,
+        // readers of the old bucket fail their version check and retry
+        bkt.begin_write();
+        ListNode* curr = bkt.head_.load(std::memory_order_relaxed);
+        bool drop_tombstones = !keep_tombstones_->load(std::memory_order_acquire);
+        while(curr) {
+            ListNode* following = curr->next_.load(std::memory_order_relaxed);
+            if(curr->tombstone_ && drop_tombstones) {
+                EpochReclaimer::instance().retire(curr);
+                curr = following;
+                continue;
+            }
+            Bucket& target = next->buckets_[hasher_(curr->key_) % next->SIZE_];
+            curr->next_.store(target.head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            target.head_.store(curr, std::memory_order_release);
+            curr = following;
+        }
+        bkt.head_.store(nullptr, std::memory_order_relaxed);
+        bkt.migrated_.store(true, std::memory_order_release);
+        bkt.end_write();
+    }
+
+    void helpMigrate() {
+        Table* table = table_.load(std::memory_order_acquire);
+        Table* next = table->next_.load(std::memory_order_acquire);
+        if(next == nullptr) {
+            return;
+        }
+        for(size_t step = 0; step < MIGRATE_STEP; ++step) {
+            size_t idx = table->migrate_cursor_.fetch_add(1);
+            if(idx >= table->SIZE_) {
+                return;
+            }
+            migrateBucket(table, next, idx);
+            if(table->migrated_cnt_.fetch_add(1) + 1 == table->SIZE_) {
+                // the last bucket is moved, exactly one thread gets here
+                table_.store(next, std::memory_order_release);
+                EpochReclaimer::instance().retire(table);
+                return;
+            }
+        }
+    }
+
+    void maybeGrow() {
+        Table* table = table_.load(std::memory_order_acquire);
+        if(count_.load(std::memory_order_relaxed) <= MAX_LOAD_FACTOR_ * table->SIZE_ ||
+            table->next_.load(std::memory_order_relaxed) != nullptr) {
+            return;
+        }
+        // allocate outside any lock, only one thread wins the CAS
+        Table* bigger = new Table(table->SIZE_ * 2);
+        Table* expected = nullptr;
+        if(!table->next_.compare_exchange_strong(expected, bigger)) {
+            delete bigger;
+        }
+    }
+
+    // where key stands in the chains, its value is copied into copy if asked for. The epoch guard must be held
+    template <typename K>
+    Probe probe(const K& key, std::optional<VT>* copy) {
+        size_t hash = hasher_(key);
+        Table* table = table_.load(std::memory_order_acquire);
+        while(true) {
+            Probe result = Probe::ABSENT;
+            bool valid = readBucket(table->buckets_[hash % table->SIZE_], [&](Bucket& bkt) {
+                result = Probe::ABSENT;
+                if(copy) {
+                    copy->reset();
+                }
+                if(ListNode* node = find(bkt, key)) {
+                    result = node->tombstone_ ? Probe::ERASED : Probe::PRESENT;
+                    if(copy && !node->tombstone_) {
+                        copy->emplace(node->value_);
+                    }
+                }
+            });
+            if(valid) {
+                return result;
+            }
+            table = table->next_.load(std::memory_order_acquire);
+        }
+    }
+
+    template <typename K>
+    bool lookup(const K& key, VT& placeholder) {
+        EpochReclaimer::Guard guard;
+        // CRITICAL: load the base before the chains. A key promoted after we read its chain is still found in the
+        // base, which cannot be freed while we hold the guard
+        Frozen* base = base_.load(std::memory_order_acquire);
+        std::optional<VT> copy;
+        switch(probe(key, &copy)) {
+            case Probe::PRESENT:
+                placeholder = std::move(*copy);
+                return true;
+            case Probe::ERASED:
+                return false;
+            default:
+                return base && base->getValue(key, placeholder);
+        }
+    }
+
+    // getValue without copying the value
+    template <typename K>
+    bool lookupKey(const K& key) {
+        EpochReclaimer::Guard guard;
+        Frozen* base = base_.load(std::memory_order_acquire);
+        Probe result = probe(key, nullptr);
+        return result == Probe::PRESENT || (result == Probe::ABSENT && base && base->contains(key));
+    }
+
+    // the key of an erased entry must stay hidden as long as some reader may look it up in the base
+    template <typename K>
+    bool needTombstone(Frozen* base, const K& key) {
+        if(base) {
+            return base->contains(key);
+        }
+        return keep_tombstones_->load(std::memory_order_acquire);
+    }
+
+    template<typename K, typename Func>
+    bool computeIfPresent(const K& key, Func& func) {
+        EpochReclaimer::Guard guard;
+        bool present = withLockedBucket(hasher_(key), [&](Bucket& bkt) {
+            ListNode* prev;
+            ListNode* curr = findLocked(bkt, key, prev);
+            if(curr == nullptr) {
+                // the key may live in the base only, bring it into the chain
+                Frozen* base = base_.load(std::memory_order_acquire);
+                VT value;
+                if(base == nullptr || !base->getValue(key, value)) {
+                    return false;
+                }
+                ListNode* new_node = new ListNode(key, std::move(value));
+                func(new_node->value_);
+                pushFrontLocked(bkt, new_node);
+                return true;
+            }
+            if(curr->tombstone_) {
+                return false;
+            }
+            modifyLocked(bkt, prev, curr, func);
+            return true;
+        });
+        helpMigrate();
+        return present;
+    }
+
+    template <typename K>
+    bool erase(const K& key) {
+        EpochReclaimer::Guard guard;
+        bool erased = withLockedBucket(hasher_(key), [this, &key](Bucket& bkt) {
+            ListNode* prev;
+            ListNode* curr = findLocked(bkt, key, prev);
+            Frozen* base = base_.load(std::memory_order_acquire);
+            if(curr == nullptr) {
+                if(base == nullptr || !base->contains(key)) {
+                    return false;
+                }
+                pushFrontLocked(bkt, new ListNode(typename ListNode::TombstoneTag(), key));
+                return true;
+            }
+            if(curr->tombstone_) {
+                return false;
+            }
+            if(needTombstone(base, key)) {
+                replaceLocked(bkt, prev, curr, new ListNode(typename ListNode::TombstoneTag(), curr->key_));
+                return true;
+            }
+            bkt.begin_write();
+            (prev ? prev->next_ : bkt.head_).store(curr->next_.load(std::memory_order_relaxed),
+                std::memory_order_release);
+            bkt.end_write();
+            EpochReclaimer::instance().retire(curr);
+            return true;
+        });
+        if(erased) {
+            count_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        helpMigrate();
+        return erased;
+    }
+
+    // an entry of the base, with the hash that picks its bucket in the chains
+    struct BaseEntry {
+        size_t hash_;
+        const KT* key_;
+        const VT* value_;
+    };
+
+    // the entries of base ordered by their bucket in table, those of bucket i are [begin[i], begin[i + 1])
+    std::vector<BaseEntry> groupBase(const Frozen& base, const Table* table, std::vector<size_t>& begin) {
+        std::vector<BaseEntry> entries;
+        entries.reserve(base.size());
+        begin.assign(table->SIZE_ + 1, 0);
+        base.for_each([&](const KT& key, const VT& value) {
+            entries.push_back(BaseEntry{hasher_(key), &key, &value});
+            ++begin[entries.back().hash_ % table->SIZE_ + 1];
+        });
+        for(size_t i = 0; i < table->SIZE_; ++i) {
+            begin[i + 1] += begin[i];
+        }
+        std::vector<BaseEntry> grouped(entries.size());
+        std::vector<size_t> fill(begin.begin(), begin.end() - 1);
+        for(const BaseEntry& entry : entries) {
+            grouped[fill[entry.hash_ % table->SIZE_]++] = entry;
+        }
+        return grouped;
+    }
+
+    /**
+     * Copy bucket idx of table into out as one consistent view, following the elements if the bucket has moved.
+     * [first, last) are the base entries of this bucket, those without a node in the chain are copied too. Both are
+     * judged by the same read, so an entry that moves from the base into the chain meanwhile is seen once either way.
+     */
+    void collectBucket(Table* table, size_t idx, BaseEntry* first, BaseEntry* last,
+        std::vector<std::pair<KT, VT>>& out) {
+        size_t old_size = out.size();
+        bool valid = readBucket(table->buckets_[idx], [&](Bucket& bkt) {
+            out.resize(old_size);
+            for(ListNode* curr = bkt.head_.load(std::memory_order_acquire); curr;
+                curr = curr->next_.load(std::memory_order_acquire)) {
+                if(!curr->tombstone_) {
+                    out.emplace_back(curr->key_, curr->value_);
+                }
+            }
+            // a tombstone hides its base entry as well
+            for(BaseEntry* entry = first; entry != last; ++entry) {
+                if(find(bkt, *entry->key_) == nullptr) {
+                    out.emplace_back(*entry->key_, *entry->value_);
+                }
+            }
+        });
+        if(!valid) {
+            // old bucket idx was split into exactly these two
+            out.resize(old_size);
+            Table* next = table->next_.load(std::memory_order_acquire);
+            BaseEntry* middle = std::partition(first, last, [next, idx](const BaseEntry& entry) {
+                return entry.hash_ % next->SIZE_ == idx;
+            });
+            collectBucket(next, idx, first, middle, out);
+            collectBucket(next, idx + table->SIZE_, middle, last, out);
+        }
+    }
+
+    // copy every entry of base the chains do not know yet into them, then detach and retire base
+    void promote(Frozen* base) {
+        base->for_each([&](const KT& key, const VT& value) {
+            if(stop_promotion_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            EpochReclaimer::Guard guard;
+            withLockedBucket(hasher_(key), [&](Bucket& bkt) {
+                ListNode* prev;
+                // a live entry or a tombstone is newer than the base
+                if(findLocked(bkt, key, prev) == nullptr) {
+                    pushFrontLocked(bkt, new ListNode(key, value));
+                }
+            });
+            maybeGrow();
+            helpMigrate();
+        });
+        if(stop_promotion_.load(std::memory_order_relaxed)) {
+            // the destructor deletes the base
+            return;
+        }
+        base_.store(nullptr, std::memory_order_release);
+        EpochReclaimer::instance().retire(base);
+        EpochReclaimer::instance().retire(new TombstoneSwitch{keep_tombstones_});
+    }
+
 public:
-    MySyncHashMap(size_t bucket_num = 19, const Hash& hasher = Hash()) : BUCKET_NUM(bucket_num), hasher_(hasher),
-    buckets_(std::vector<std::unique_ptr<MySyncForwardList<KVPair>>>(bucket_num)) {
-        for(int i = 0; i<bucket_num; ++i) {
-            buckets_[i] = std::make_unique<MySyncForwardList<KVPair>>();
+    MySyncHashMap(size_t bucket_num = 19, const Hash& hasher = Hash(), double max_load_factor = 1.0,
+        const KeyEqual& equal = KeyEqual()) :
+    MAX_LOAD_FACTOR_(max_load_factor), hasher_(hasher), equal_(equal),
+    table_(new Table(std::max<size_t>(bucket_num, 1))), count_(0), base_(nullptr),
+    keep_tombstones_(std::make_shared<std::atomic<bool>>(false)), stop_promotion_(false) {}
+
+    ~MySyncHashMap() {
+        stop_promotion_.store(true);
+        if(promoter_.joinable()) {
+            promoter_.join();
+        }
+        delete base_.load();
+        Table* table = table_.load();
+        while(table) {
+            Table* next = table->next_.load();
+            delete table;
+            table = next;
         }
     }
 
@@ -47,34 +595,297 @@ public:
     MySyncHashMap& operator=(const MySyncHashMap&) = delete;
 
     bool getValue(const KT& key, VT& placeholder) {
-        MySyncForwardList<KVPair>& bkt = getBucket(key);
-        std::shared_ptr<KVPair> ret = bkt.find_first_if([&key](const KVPair& p) {
-            return p.key_ == key;
-        });
-        if(ret == nullptr) {
-            return false;
+        return lookup(key, placeholder);
+    }
+
+    template <typename K> requires IS_TRANSPARENT
+    bool getValue(const K& key, VT& placeholder) {
+        return lookup(key, placeholder);
+    }
+
+    bool contains(const KT& key) {
+        return lookupKey(key);
+    }
+
+    template <typename K> requires IS_TRANSPARENT
+    bool contains(const K& key) {
+        return lookupKey(key);
+    }
+
+    /**
+     * Look up all keys at once, out[i] is filled for every keys[i] found (and reset otherwise). Keys are grouped by
+     * bucket, each bucket is read once for all of its keys, and buckets further down the batch are prefetched while
+     * the current one is walked so the cache misses of different buckets overlap. Return the number of keys found.
+     */
+    size_t multi_get(const std::vector<KT>& keys, std::vector<std::optional<VT>>& out) {
+        EpochReclaimer::Guard guard;
+        out.assign(keys.size(), std::nullopt);
+        Table* table = table_.load(std::memory_order_acquire);
+        auto order = groupByBucket(table, keys.size(), [&keys](size_t i) -> const KT& { return keys[i]; });
+        Frozen* base = base_.load(std::memory_order_acquire);
+        // per key: does the chain hold a node for it, live or tombstone
+        std::vector<bool> in_chain(keys.size(), false);
+        size_t found = 0;
+        for(size_t begin = 0; begin < order.size();) {
+            size_t end = begin;
+            while(end < order.size() && order[end].first == order[begin].first) {
+                ++end;
+            }
+            prefetchAhead(table, order, begin);
+            bool valid = readBucket(table->buckets_[order[begin].first], [&](Bucket& bkt) {
+                for(size_t i = begin; i < end; ++i) {
+                    std::optional<VT>& slot = out[order[i].second];
+                    slot.reset();
+                    ListNode* node = find(bkt, keys[order[i].second]);
+                    in_chain[order[i].second] = node != nullptr;
+                    if(node && !node->tombstone_) {
+                        slot.emplace(node->value_);
+                    }
+                }
+            });
+            for(size_t i = begin; i < end; ++i) {
+                size_t idx = order[i].second;
+                VT value;
+                if(!valid) {
+                    // the bucket is being resized away, rare enough to go key by key
+                    out[idx].reset();
+                    if(getValue(keys[idx], value)) {
+                        out[idx].emplace(std::move(value));
+                    }
+                } else if(!in_chain[idx] && base && base->getValue(keys[idx], value)) {
+                    out[idx].emplace(std::move(value));
+                }
+                found += out[idx].has_value();
+            }
+            begin = end;
         }
-        placeholder = *ret->value_;
-        return true;
+        return found;
     }
 
+    // return true for insert and false for update
     template<typename KK, typename VV>
-        bool insertOrUpdate(KK&& key, VV&& value) {
-        MySyncForwardList<KVPair>& bkt = getBucket(key);
-        return bkt.insert_or_update([&key](const KVPair& p) {
-            return key == p.key_;
-        }, KVPair(std::forward<KK>(key), std::forward<VV>(value)));
+    bool insertOrUpdate(KK&& key, VV&& value) {
+        if constexpr (!IS_TRANSPARENT && !std::is_same_v<std::remove_cvref_t<KK>, KT>) {
+            // build the key once instead of once for hashing and once per comparison. The else matters: without it
+            // the code below is still instantiated with KK, which Hash and KeyEqual may not accept
+            return insertOrUpdate(KT(std::forward<KK>(key)), std::forward<VV>(value));
+        } else {
+            EpochReclaimer::Guard guard;
+            size_t hash = hasher_(key);
+            bool inserted = withLockedBucket(hash, [&](Bucket& bkt) {
+                return insertOrUpdateLocked(bkt, std::forward<KK>(key), std::forward<VV>(value));
+            });
+            if(inserted) {
+                count_.fetch_add(1, std::memory_order_relaxed);
+                maybeGrow();
+            }
+            helpMigrate();
+            return inserted;
+        }
+    }
+
+    /**
+     * insertOrUpdate for every pair, in order, taking each bucket lock once for all pairs that hash to it.
+     * Return the number of keys inserted.
+     */
+    size_t multi_insert_or_update(const std::vector<std::pair<KT, VT>>& pairs) {
+        EpochReclaimer::Guard guard;
+        Table* table = table_.load(std::memory_order_acquire);
+        auto order = groupByBucket(table, pairs.size(), [&pairs](size_t i) -> const KT& { return pairs[i].first; });
+        size_t inserted = 0;
+        size_t inserted_elsewhere = 0;
+        for(size_t begin = 0; begin < order.size();) {
+            size_t end = begin;
+            while(end < order.size() && order[end].first == order[begin].first) {
+                ++end;
+            }
+            prefetchAhead(table, order, begin);
+            Bucket& bkt = table->buckets_[order[begin].first];
+            std::unique_lock<std::mutex> lock(bkt.mtx_);
+            if(!bkt.migrated_.load(std::memory_order_relaxed)) {
+                for(size_t i = begin; i < end; ++i) {
+                    const auto& [key, value] = pairs[order[i].second];
+                    inserted += insertOrUpdateLocked(bkt, key, value);
+                }
+            } else {
+                lock.unlock();
+                for(size_t i = begin; i < end; ++i) {
+                    const auto& [key, value] = pairs[order[i].second];
+                    // counted and grown by insertOrUpdate itself
+                    inserted_elsewhere += insertOrUpdate(key, value);
+                }
+            }
+            begin = end;
+        }
+        if(inserted) {
+            count_.fetch_add(inserted, std::memory_order_relaxed);
+            maybeGrow();
+        }
+        helpMigrate();
+        return inserted + inserted_elsewhere;
+    }
+
+    /**
+     * Run func(VT&) on the value of key under the bucket lock, a missing key is first inserted with VT().
+     * For a trivially copyable VT this allocates nothing unless the key is new, so e.g. counting is
+     * upsert(key, [](long& cnt) { ++cnt; }). Return true if the key was inserted.
+     */
+    template<typename KK, typename Func>
+    bool upsert(KK&& key, Func func) {
+        if constexpr (!IS_TRANSPARENT && !std::is_same_v<std::remove_cvref_t<KK>, KT>) {
+            // build the key once, see insertOrUpdate
+            return upsert(KT(std::forward<KK>(key)), std::move(func));
+        } else {
+            EpochReclaimer::Guard guard;
+            size_t hash = hasher_(key);
+            bool inserted = withLockedBucket(hash, [&](Bucket& bkt) {
+                ListNode* prev;
+                ListNode* curr = findLocked(bkt, key, prev);
+                if(curr && !curr->tombstone_) {
+                    modifyLocked(bkt, prev, curr, func);
+                    return false;
+                }
+                if(curr) {
+                    ListNode* new_node = new ListNode(curr->key_, VT());
+                    func(new_node->value_);
+                    replaceLocked(bkt, prev, curr, new_node);
+                    return true;
+                }
+                // a key of the base starts from its base value
+                Frozen* base = base_.load(std::memory_order_acquire);
+                VT value{};
+                bool in_base = base && base->getValue(key, value);
+                ListNode* new_node = new ListNode(std::forward<KK>(key), std::move(value));
+                func(new_node->value_);
+                pushFrontLocked(bkt, new_node);
+                return !in_base;
+            });
+            if(inserted) {
+                count_.fetch_add(1, std::memory_order_relaxed);
+                maybeGrow();
+            }
+            helpMigrate();
+            return inserted;
+        }
+    }
+
+    // run func(VT&) on the value of key under the bucket lock, false if there is no such key
+    template<typename Func>
+    bool compute_if_present(const KT& key, Func func) {
+        return computeIfPresent(key, func);
+    }
+
+    template<typename K, typename Func> requires IS_TRANSPARENT
+    bool compute_if_present(const K& key, Func func) {
+        return computeIfPresent(key, func);
     }
 
     // true if key exists
     bool eraseEntry(const KT& key) {
-        MySyncForwardList<KVPair>& bkt = getBucket(key);
-        return bkt.remove_first_if([&key](const KVPair& p) {
-            return key == p.key_;
+        return erase(key);
+    }
+
+    template <typename K> requires IS_TRANSPARENT
+    bool eraseEntry(const K& key) {
+        return erase(key);
+    }
+
+    /**
+     * Call func(const KT&, const VT&) for every entry while writers keep going. Weakly consistent: each bucket is
+     * copied out as one consistent view and func runs on the copy with no lock held (so it may use the map), but
+     * different buckets are seen at different moments. An entry present during the whole call is visited exactly
+     * once, even across a resize or while it is copied from a base (see load_mmap) into the chains. With a base
+     * attached, its entries are first grouped by bucket, which costs three words of memory per entry.
+     */
+    template <typename Func>
+    void for_each(Func func) {
+        EpochReclaimer::Guard guard;
+        Frozen* base = base_.load(std::memory_order_acquire);
+        Table* table = table_.load(std::memory_order_acquire);
+        std::vector<size_t> base_begin;
+        std::vector<BaseEntry> base_entries;
+        if(base) {
+            base_entries = groupBase(*base, table, base_begin);
+        }
+        std::vector<std::pair<KT, VT>> entries;
+        for(size_t idx = 0; idx < table->SIZE_; ++idx) {
+            entries.clear();
+            BaseEntry* first = base ? base_entries.data() + base_begin[idx] : nullptr;
+            BaseEntry* last = base ? base_entries.data() + base_begin[idx + 1] : nullptr;
+            collectBucket(table, idx, first, last, entries);
+            for(const auto& [key, value] : entries) {
+                func(key, value);
+            }
+        }
+    }
+
+    // all entries, with the guarantees of for_each
+    std::vector<std::pair<KT, VT>> snapshot() {
+        std::vector<std::pair<KT, VT>> entries;
+        entries.reserve(size());
+        for_each([&entries](const KT& key, const VT& value) {
+            entries.emplace_back(key, value);
         });
+        return entries;
     }
 
+    /**
+     * An immutable copy of the current content (a snapshot(), see for_each for its consistency) laid out by a minimal
+     * perfect hash, for tables that are built once and then only read. The map itself stays usable.
+     */
+    MyFrozenHashMap<KT, VT, Hash, KeyEqual> freeze() {
+        return MyFrozenHashMap<KT, VT, Hash, KeyEqual>(snapshot(), hasher_, equal_);
+    }
+
+    // write the content to path as a MyFrozenHashMap file, see freeze()
+    void save(const std::string& path) {
+        freeze().save(path);
+    }
+
+    /**
+     * Serve the table saved at path from a read-only mapping, with this map's chains as the writable layer on top.
+     * Nothing is read up front, pages fault in as lookups touch them. With promote_in_background a thread copies
+     * the base into the chains meanwhile (entries written or erased since win) and unmaps it when done.
+     * The map must be empty and have nothing attached yet, otherwise std::logic_error is thrown.
+     */
+    void load_mmap(const std::string& path, bool promote_in_background = false) {
+        if(base_.load() != nullptr || promoter_.joinable() || count_.load() != 0) {
+            throw std::logic_error("MySyncHashMap::load_mmap needs an empty map");
+        }
+        Frozen* base = new Frozen(Frozen::load_mmap(path, hasher_, equal_));
+        keep_tombstones_->store(true);
+        count_.fetch_add(static_cast<long>(base->size()));
+        base_.store(base, std::memory_order_release);
+        if(promote_in_background) {
+            promoter_ = std::thread([this, base]() {
+                promote(base);
+            });
+        }
+    }
 
+    // true while a base loaded by load_mmap() is still attached
+    bool hasBase() const {
+        return base_.load(std::memory_order_acquire) != nullptr;
+    }
+
+    // number of entries, takes no lock and may lag behind operations in flight
+    size_t size() const {
+        return std::max<long>(count_.load(std::memory_order_relaxed), 0);
+    }
+
+    size_t bucketCount() {
+        EpochReclaimer::Guard guard;
+        return table_.load(std::memory_order_acquire)->SIZE_;
+    }
+};
+
+// hashes std::string, std::string_view and C strings alike, for MySyncHashMap<std::string, VT, MyTransparentStringHash,
+// std::equal_to<>>
+struct MyTransparentStringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>()(str);
+    }
 };
 
 #endif //MY_SYNC_HASH_MAP_H
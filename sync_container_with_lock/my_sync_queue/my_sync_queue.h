@@ -6,7 +6,9 @@
 #define MY_SYNC_QUEU_H
 
 #include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "../../my_utility/my_event_count.h"
 
 template <typename T>
 class MySyncQueue {
@@ -18,37 +20,189 @@ class MySyncQueue {
         QueueNode(U&& data) : data_(std::make_shared<T>(std::forward<U>(data))), next_(nullptr) {}
     };
 public:
-    MySyncQueue(): front_(new QueueNode()), rear_(front_.get()) {}
+    // capacity 0 means unbounded
+    explicit MySyncQueue(size_t capacity = 0): front_(new QueueNode()), rear_(front_.get()), CAPACITY_(capacity),
+    size_(0), closed_(false), blocked_ns_(0) {}
+    // block until there is space, false if the queue is closed while waiting
     template <typename U>
-    void push(U&& data);
+    bool push(U&& data);
+    // never block, false if the queue is full
+    template <typename U>
+    bool try_push(U&& data);
+    // block for at most timeout, false if still full or closed
+    template <typename U, typename Rep, typename Period>
+    bool push_for(U&& data, const std::chrono::duration<Rep, Period>& timeout);
     bool tryPop(std::shared_ptr<T>& sptr);
     std::shared_ptr<T> pop();
     bool pop(T&);
     void close();
+    size_t size() const;
+    size_t capacity() const;
+    // accumulated time producers spent waiting for a free slot
+    std::chrono::nanoseconds producer_blocked_time() const;
 private:
+    // load is the order of the first read of size_, seq_cst for the re-check after registering in not_full_
+    bool try_reserve(std::memory_order load = std::memory_order_relaxed);
+    void release_slot();
+    // deadline == nullptr means wait forever
+    bool wait_for_slot(const std::chrono::steady_clock::time_point* deadline);
+    // called with front_lock_ held, false if the queue is closed
+    bool wait_for_data(std::unique_lock<std::mutex>& front_lock);
+    template <typename U>
+    void link(U&& data);
+
     std::unique_ptr<QueueNode> front_;
-    QueueNode* rear_;
+    // only written under rear_lock_, but consumers read it without any lock to tell if the queue is empty
+    std::atomic<QueueNode*> rear_;
     std::mutex front_lock_;
     std::mutex rear_lock_;
-    std::condition_variable cv_;
+    // consumers sleep here, producers only pay for a wakeup when some consumer is registered
+    EventCount not_empty_;
+    const size_t CAPACITY_;
+    // counts reserved slots, so producers claim space without touching either queue lock
+    std::atomic<size_t> size_;
+    // producers only sleep here when the queue is full
+    EventCount not_full_;
     std::atomic<bool> closed_;
+    std::atomic<uint64_t> blocked_ns_;
 };
 
+template<typename T>
+bool MySyncQueue<T>::try_reserve(std::memory_order load) {
+    if(CAPACITY_ == 0) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    size_t current = size_.load(load);
+    do {
+        if(current >= CAPACITY_) {
+            return false;
+        }
+    } while(!size_.compare_exchange_weak(current, current + 1));
+    return true;
+}
+
+template<typename T>
+void MySyncQueue<T>::release_slot() {
+    // seq_cst, pairs with the registration in not_full_.prepare_wait()
+    size_.fetch_sub(1);
+    not_full_.notify_one();
+}
+
+template<typename T>
+bool MySyncQueue<T>::wait_for_slot(const std::chrono::steady_clock::time_point* deadline) {
+    auto start = std::chrono::steady_clock::now();
+    bool reserved = false;
+    while(true) {
+        if(closed_) {
+            break;
+        }
+        uint64_t key = not_full_.prepare_wait();
+        // CRITICAL: seq_cst, a relaxed load may still see the queue full after a consumer released a slot and found
+        // no waiter registered, then we would sleep through the only notification
+        if(closed_ || (reserved = try_reserve(std::memory_order_seq_cst))) {
+            not_full_.cancel_wait();
+            break;
+        }
+        if(deadline == nullptr) {
+            not_full_.wait(key);
+        } else if(!not_full_.wait_until(key, *deadline)) {
+            // one last chance after timeout
+            reserved = !closed_ && try_reserve(std::memory_order_seq_cst);
+            break;
+        }
+        if((reserved = try_reserve())) {
+            break;
+        }
+    }
+    blocked_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+    return reserved;
+}
+
 template<typename T>
 template<typename U>
-void MySyncQueue<T>::push(U &&data) {
+void MySyncQueue<T>::link(U &&data) {
     // suppose you use raw pointer, it's possible that the first allocation succeeds while the second fails and throws,
     // you will left the pointer undeleted!
-    std::shared_ptr<T> sptr = std::make_shared<T>(std::forward<U>(data));
-    std::unique_ptr<QueueNode> uptr = std::make_unique<QueueNode>();
+    std::shared_ptr<T> sptr;
+    std::unique_ptr<QueueNode> uptr;
+    try {
+        sptr = std::make_shared<T>(std::forward<U>(data));
+        uptr = std::make_unique<QueueNode>();
+    } catch (...) {
+        // give the reserved slot back
+        release_slot();
+        throw;
+    }
     // minimize the critical region
     {
         std::lock_guard<std::mutex> grd(rear_lock_);
-        rear_->data_ = sptr;
-        rear_->next_ = std::move(uptr);
-        rear_ = rear_->next_.get();
+        QueueNode* rear = rear_.load(std::memory_order_relaxed);
+        rear->data_ = sptr;
+        rear->next_ = std::move(uptr);
+        // seq_cst publishes the node and pairs with the registration in not_empty_.prepare_wait()
+        rear_.store(rear->next_.get());
+    }
+    // no futex call unless some consumer is asleep
+    not_empty_.notify_one();
+}
+
+template<typename T>
+template<typename U>
+bool MySyncQueue<T>::push(U &&data) {
+    // slow path only when the queue is full
+    if(!try_reserve() && !wait_for_slot(nullptr)) {
+        return false;
+    }
+    link(std::forward<U>(data));
+    return true;
+}
+
+template<typename T>
+template<typename U>
+bool MySyncQueue<T>::try_push(U &&data) {
+    if(!try_reserve()) {
+        return false;
+    }
+    link(std::forward<U>(data));
+    return true;
+}
+
+template<typename T>
+template<typename U, typename Rep, typename Period>
+bool MySyncQueue<T>::push_for(U &&data, const std::chrono::duration<Rep, Period>& timeout) {
+    if(!try_reserve()) {
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+        if(!wait_for_slot(&deadline)) {
+            return false;
+        }
+    }
+    link(std::forward<U>(data));
+    return true;
+}
+
+template<typename T>
+bool MySyncQueue<T>::wait_for_data(std::unique_lock<std::mutex>& front_lock) {
+    while(true) {
+        if(closed_) {
+            return false;
+        }
+        if(front_.get() != rear_.load()) {
+            return true;
+        }
+        uint64_t key = not_empty_.prepare_wait();
+        // re-check after registration, a producer publishing before it may have skipped the notification
+        if(closed_ || front_.get() != rear_.load()) {
+            not_empty_.cancel_wait();
+            continue;
+        }
+        // do not sleep with front_lock_, other consumers should be able to register as well
+        front_lock.unlock();
+        not_empty_.wait(key);
+        front_lock.lock();
     }
-    cv_.notify_one();
 }
 
 template<typename T>
@@ -56,16 +210,15 @@ bool MySyncQueue<T>::tryPop(std::shared_ptr<T>& sptr) {
     std::unique_ptr<QueueNode> defer;
     {
         std::lock_guard<std::mutex> front_uni_lock(front_lock_);
-        {
-            std::lock_guard<std::mutex> rear_guard(rear_lock_);
-            if(front_.get() == rear_) {
-                return false;
-            }
+        // no need for rear_lock_: rear_ only moves forward, a stale value can only make us report empty
+        if(front_.get() == rear_.load(std::memory_order_acquire)) {
+            return false;
         }
         sptr = front_->data_;
         defer = std::move(front_);
         front_ = std::move(defer->next_);
     }
+    release_slot();
     return true;
 }
 
@@ -75,20 +228,14 @@ std::shared_ptr<T> MySyncQueue<T>::pop() {
     std::shared_ptr<T> data;
     {
         std::unique_lock<std::mutex> lock(front_lock_);
-        cv_.wait(lock, [this]() {
-            if(closed_) {
-                return true;
-            }
-            std::lock_guard<std::mutex> rlock(rear_lock_);
-            return front_.get() != rear_;
-        });
-        if(closed_) {
+        if(!wait_for_data(lock)) {
             return nullptr;
         }
         data = front_->data_;
         defer = std::move(front_);
         front_ = std::move(defer->next_);
     }
+    release_slot();
     return data;
 }
 
@@ -97,14 +244,7 @@ bool MySyncQueue<T>::pop(T& placeholder) {
     std::unique_ptr<QueueNode> defer;
     {
         std::unique_lock<std::mutex> lock(front_lock_);
-        cv_.wait(lock, [this]() {
-            if(closed_) {
-                return true;
-            }
-            std::lock_guard<std::mutex> rlock(rear_lock_);
-            return front_.get() != rear_;
-        });
-        if(closed_) {
+        if(!wait_for_data(lock)) {
             return false;
         }
         // if this move throws, front_->data_ is damaged
@@ -114,13 +254,30 @@ bool MySyncQueue<T>::pop(T& placeholder) {
         // noexcept
         front_ = std::move(defer->next_);
     }
+    release_slot();
     return true;
 }
 
 template<typename T>
 void MySyncQueue<T>::close() {
     closed_ = true;
-    cv_.notify_all();
+    not_empty_.notify_all();
+    not_full_.notify_all();
+}
+
+template<typename T>
+size_t MySyncQueue<T>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+size_t MySyncQueue<T>::capacity() const {
+    return CAPACITY_;
+}
+
+template<typename T>
+std::chrono::nanoseconds MySyncQueue<T>::producer_blocked_time() const {
+    return std::chrono::nanoseconds(blocked_ns_.load(std::memory_order_relaxed));
 }
 
 
@@ -0,0 +1,235 @@
+//
+// Created by Charles Green on 11/4/25.
+//
+
+#ifndef MY_TASK_GRAPH_H
+#define MY_TASK_GRAPH_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "my_thread_pool.h"
+#include "../../my_utility/my_task.h"
+
+/**
+ * A DAG of tasks run on a MyThreadPool, instead of pool tasks that block on the futures of their predecessors:
+ *  - add() declares a node, precede(a, b) an edge, b starts only after a has finished;
+ *  - run() gives every node a counter of unfinished predecessors. A finishing node counts its successors down and a
+ *    successor is scheduled the moment its counter hits 0, so no worker ever waits on another task. The worker goes on
+ *    with the first successor it made ready itself and posts the others;
+ *  - the graph survives run(): the nodes are kept, the edges are compiled into flat arrays on the first run after a
+ *    change, so running it again costs one counter reset per node.
+ * If a node throws, the nodes not started yet are skipped and run() rethrows the first exception once everything has
+ * settled. One run at a time, and never from a task of the pool it runs on: run() blocks its caller.
+ * A node is never waited for room in the pool: when a bounded queue is full, the thread that made the node ready runs
+ * it itself, a worker posting into a full queue could otherwise end up waiting for itself. A pool that refuses the
+ * node (it is stopped) counts as a failure of that node, the rest is skipped and run() throws what the pool threw.
+ */
+class TaskGraph {
+public:
+    using NodeId = uint32_t;
+
+private:
+    static constexpr NodeId NONE = UINT32_MAX;
+
+    std::vector<MyTask> nodes_;
+    std::vector<std::pair<NodeId, NodeId>> edges_;
+    // the compiled edges, the successors of node i are successors_[first_successor_[i] .. first_successor_[i + 1])
+    std::vector<uint32_t> first_successor_;
+    std::vector<NodeId> successors_;
+    std::vector<uint32_t> predecessor_num_;
+    std::vector<NodeId> roots_;
+    bool compiled_ = false;
+
+    // the state of the current run
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_;
+    size_t pending_size_ = 0;
+    std::atomic<size_t> remaining_{0};
+    // set by the last node to finish
+    bool done_ = false;
+    std::mutex done_mtx_;
+    std::condition_variable done_cv_;
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+    std::mutex error_mtx_;
+    MyThreadPool* pool_ = nullptr;
+    MyThreadPool::Priority priority_ = MyThreadPool::NORMAL;
+
+    // counting sort of the edges by source, then Kahn's algorithm to make sure every node can become ready
+    void compile() {
+        const size_t NODE_NUM = nodes_.size();
+        first_successor_.assign(NODE_NUM + 1, 0);
+        predecessor_num_.assign(NODE_NUM, 0);
+        for(const auto& [from, to] : edges_) {
+            ++first_successor_[from + 1];
+            ++predecessor_num_[to];
+        }
+        for(size_t i = 0; i < NODE_NUM; ++i) {
+            first_successor_[i + 1] += first_successor_[i];
+        }
+        successors_.resize(edges_.size());
+        std::vector<uint32_t> fill(first_successor_.begin(), first_successor_.end() - 1);
+        for(const auto& [from, to] : edges_) {
+            successors_[fill[from]++] = to;
+        }
+        roots_.clear();
+        for(NodeId i = 0; i < NODE_NUM; ++i) {
+            if(predecessor_num_[i] == 0) {
+                roots_.push_back(i);
+            }
+        }
+        std::vector<uint32_t> waiting(predecessor_num_);
+        std::vector<NodeId> ready(roots_);
+        size_t reached = 0;
+        while(!ready.empty()) {
+            NodeId node = ready.back();
+            ready.pop_back();
+            ++reached;
+            for(uint32_t e = first_successor_[node]; e < first_successor_[node + 1]; ++e) {
+                if(--waiting[successors_[e]] == 0) {
+                    ready.push_back(successors_[e]);
+                }
+            }
+        }
+        if(reached != NODE_NUM) {
+            throw std::invalid_argument("task graph has a cycle");
+        }
+        if(pending_size_ != NODE_NUM) {
+            pending_ = std::make_unique<std::atomic<uint32_t>[]>(NODE_NUM);
+            pending_size_ = NODE_NUM;
+        }
+        compiled_ = true;
+    }
+
+    // keep the first error of the run, the nodes not started yet are skipped from now on
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        if(!error_) {
+            error_ = std::move(error);
+        }
+        failed_.store(true, std::memory_order_relaxed);
+    }
+
+    // false if the pool did not take node, the caller has to run it then. A full queue is not waited for
+    bool schedule(NodeId node) {
+        try {
+            return pool_->try_post([this, node]() { execute(node); }, priority_);
+        } catch (...) {
+            // stopped, nothing after this node will run, but it still has to be counted down
+            fail(std::current_exception());
+            return false;
+        }
+    }
+
+    // run node, then whatever it makes ready, on this thread as long as there is exactly one to go on with, or the
+    // pool does not take the others
+    void execute(NodeId node) {
+        // ready nodes the pool did not take
+        std::vector<NodeId> own;
+        while(node != NONE) {
+            if(!failed_.load(std::memory_order_relaxed)) {
+                try {
+                    nodes_[node]();
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            NodeId next = NONE;
+            for(uint32_t e = first_successor_[node]; e < first_successor_[node + 1]; ++e) {
+                NodeId successor = successors_[e];
+                // acq_rel: the last predecessor to finish publishes the writes of all of them to the successor
+                if(pending_[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(next == NONE) {
+                        next = successor;
+                    } else if(!schedule(successor)) {
+                        own.push_back(successor);
+                    }
+                }
+            }
+            if(remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                // CRITICAL: notify under the lock, run() cannot return and destroy the graph before we let go of it.
+                // next is NONE and own is empty here, no node is left to make ready
+                std::lock_guard<std::mutex> lock(done_mtx_);
+                done_ = true;
+                done_cv_.notify_all();
+                return;
+            }
+            if(next == NONE && !own.empty()) {
+                next = own.back();
+                own.pop_back();
+            }
+            node = next;
+        }
+    }
+
+public:
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // func is called once per run, and must stay callable for the next one
+    template <typename F>
+    NodeId add(F&& func) {
+        if(nodes_.size() >= NONE) {
+            throw std::length_error("too many nodes in a task graph");
+        }
+        nodes_.emplace_back(std::forward<F>(func));
+        compiled_ = false;
+        return static_cast<NodeId>(nodes_.size() - 1);
+    }
+
+    // before has to finish before after starts
+    void precede(NodeId before, NodeId after) {
+        if(before >= nodes_.size() || after >= nodes_.size()) {
+            throw std::out_of_range("no such node in the task graph");
+        }
+        edges_.emplace_back(before, after);
+        compiled_ = false;
+    }
+
+    size_t size() const {
+        return nodes_.size();
+    }
+
+    size_t edge_num() const {
+        return edges_.size();
+    }
+
+    // run every node once and wait for all of them. Throws std::invalid_argument on a cycle, before anything runs, and
+    // std::runtime_error if the pool is stopped
+    void run(MyThreadPool& pool, MyThreadPool::Priority priority = MyThreadPool::NORMAL) {
+        if(!compiled_) {
+            compile();
+        }
+        if(nodes_.empty()) {
+            return;
+        }
+        for(size_t i = 0; i < nodes_.size(); ++i) {
+            pending_[i].store(predecessor_num_[i], std::memory_order_relaxed);
+        }
+        remaining_.store(nodes_.size(), std::memory_order_relaxed);
+        done_ = false;
+        failed_.store(false, std::memory_order_relaxed);
+        error_ = nullptr;
+        pool_ = &pool;
+        priority_ = priority;
+        // try_post() publishes all of the above to the workers. A root the pool does not take runs right here
+        for(NodeId root : roots_) {
+            if(!schedule(root)) {
+                execute(root);
+            }
+        }
+        std::unique_lock<std::mutex> lock(done_mtx_);
+        done_cv_.wait(lock, [this]() { return done_; });
+        if(error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+};
+
+#endif //MY_TASK_GRAPH_H
@@ -4,18 +4,34 @@
 
 #include "my_thread_pool.h"
 
-#include <assert.h>
-#include <functional>
-#include <mutex>
+#include <algorithm>
+#include <stdexcept>
 #include <thread>
 
-MyThreadPool::MyThreadPool(int pool_size): POOL_SIZE_(pool_size) {
-    workers_.reserve(pool_size);
-    for(int i=0;i<pool_size; ++i) {
-        workers_.emplace_back(std::make_unique<MyWorker>(i, this));
-        std::thread t([](int id, MyThreadPool* parent){parent->workers_[id]->work();}, i, this);
-        t.detach();
-        available_workers_.push(i);
+namespace {
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+MyThreadPool::MyThreadPool(int pool_size, size_t capacity, const MyAffinityPolicy& affinity):
+MyThreadPool(pool_size, pool_size, std::chrono::milliseconds::zero(), capacity, affinity) {}
+
+MyThreadPool::MyThreadPool(int min_threads, int max_threads, std::chrono::milliseconds idle_timeout, size_t capacity,
+    const MyAffinityPolicy& affinity):
+MIN_THREADS_(std::max(min_threads, 0)), MAX_THREADS_(std::max({max_threads, min_threads, 1})),
+IDLE_TIMEOUT_(idle_timeout), CAPACITY_(capacity), count_(0), exit_signals_(0), aging_limit_(16), live_(0),
+idle_(0), slot_used_(MAX_THREADS_, false), cpu_of_slot_(affinity.kind_ == MyAffinityPolicy::NONE ?
+    std::vector<int>(MAX_THREADS_, -1) : MyCpuTopology().place(affinity, MAX_THREADS_)),
+counters_(std::make_unique<MyWorkerCounters[]>(MAX_THREADS_)), spawned_(0), retired_(0),
+stopped_(false), submitting_(0) {
+    for(Level& level : levels_) {
+        level.ring_.resize(16);
+    }
+    for(int i=0;i<MIN_THREADS_; ++i) {
+        live_.fetch_add(1);
+        spawnWorker();
     }
 }
 
@@ -23,112 +39,329 @@ MyThreadPool::~MyThreadPool() {
     stopAll();
 }
 
-void MyThreadPool::submit(std::function<void()> task) {
-    // check if these is an available worker
-    int worker_id = -1;
-    {
-        std::unique_lock<std::mutex> lock(mtx_);
-        // wait until we have one
-        cv_.wait(lock, [this]() {
-            return stopped_ || !available_workers_.empty();
-        });
-        if(stopped_) {
-            throw std::runtime_error("thead pool has been closed");
-        }
-        worker_id = available_workers_.front();
-        available_workers_.pop();
+bool MyThreadPool::enterSubmit() {
+    // seq_cst on both sides: either stopAll() sees us in submitting_, or we see stopped_
+    submitting_.fetch_add(1);
+    if(stopped_.load()) {
+        submitting_.fetch_sub(1);
+        return false;
     }
-    workers_[worker_id]->acceptTask(task);
+    return true;
 }
 
-void MyThreadPool::syncStop(int id) {
-    workers_[id]->syncStop();
+void MyThreadPool::leaveSubmit() {
+    submitting_.fetch_sub(1);
 }
 
-void MyThreadPool::stopAll() {
-    {
-        // stop the service and wake up all working thread
-        std::lock_guard<std::mutex> lk(mtx_);
-        if(stopped_)
-            // cannot stop twice
-            return;
-        stopped_ = true;
-        cv_.notify_all();
-    }
-    for(int i=0;i<POOL_SIZE_;++i) {
-        // stop all
-        std::thread stop_i_thd([](int id, MyThreadPool* pool) {
-            pool->workers_[id]->syncStop();
-        }, i, this);
-        stop_i_thd.detach();
-    }
-    std::unique_lock<std::mutex> lock(mtx_);
-    cv_.wait(lock, [this]() {
-        return available_workers_.size() == POOL_SIZE_;
-    });
-    while(!available_workers_.empty()) {
-        // clear the workers
-        available_workers_.pop();
-    }
-}
-
-void MyThreadPool::report_finish(int id) {
+void MyThreadPool::spawnWorker() {
+    std::unique_lock<std::mutex> lock(workers_mtx_);
+    // live_ never exceeds MAX_THREADS_, but a retiring worker leaves live_ before it frees its slot. Then it only has
+    // to get workers_mtx_, let it
+    int slot;
+    while((slot = static_cast<int>(std::find(slot_used_.begin(), slot_used_.end(), false) - slot_used_.begin())) ==
+        MAX_THREADS_) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+    try {
+        auto self = workers_.emplace(workers_.end());
+        self->slot_ = slot;
+        // the worker needs workers_mtx_ to touch its own entry, so it cannot see it before this assignment
+        self->thread_ = std::thread(&MyThreadPool::work, this, self);
+        slot_used_[slot] = true;
+        if(cpu_of_slot_[slot] >= 0 && !MyCpuTopology::pin(self->thread_.native_handle(), cpu_of_slot_[slot])) {
+            cpu_of_slot_[slot] = -1;
+        }
+    } catch (...) {
+        if(!workers_.empty() && !workers_.back().thread_.joinable()) {
+            workers_.pop_back();
+        }
+        std::lock_guard<std::mutex> queue_lock(queue_mtx_);
+        live_.fetch_sub(1);
+        throw;
+    }
+    spawned_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MyThreadPool::tryPush(MyTask& task, Priority priority) {
+    bool spawn = false;
+    // read outside the lock, the clock is the slowest part of a push
+    int64_t now = nowNs();
     {
-       std::lock_guard<std::mutex> lock(mtx_);
-        available_workers_.push(id);
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        size_t count = count_.load(std::memory_order_relaxed);
+        if(CAPACITY_ != 0 && count >= CAPACITY_) {
+            return false;
+        }
+        Level& level = levels_[priority];
+        if(level.size_ == level.ring_.size()) {
+            // full, unroll into a ring twice the size
+            std::vector<Queued> bigger(level.ring_.size() * 2);
+            for(size_t i = 0; i < level.size_; ++i) {
+                bigger[i] = std::move(level.ring_[(level.head_ + i) % level.ring_.size()]);
+            }
+            level.ring_.swap(bigger);
+            level.head_ = 0;
+        }
+        // more queued tasks than idle workers to take them
+        spawn = count + 1 > static_cast<size_t>(idle_.load(std::memory_order_relaxed)) &&
+            live_.load(std::memory_order_relaxed) < MAX_THREADS_;
+        if(spawn) {
+            // take the place now, a concurrent submit already sees it taken
+            live_.fetch_add(1);
+        }
+        Queued& slot = level.ring_[(level.head_ + level.size_) % level.ring_.size()];
+        slot.task_ = std::move(task);
+        slot.enqueued_ns_ = now;
+        ++level.size_;
+        // seq_cst, pairs with the registration in not_empty_.prepare_wait()
+        count_.store(count + 1);
+    }
+    not_empty_.notify_one();
+    if(spawn) {
+        spawnWorker();
     }
-    cv_.notify_one();
+    return true;
 }
 
-size_t MyThreadPool::size() const {
-    return POOL_SIZE_;
+void MyThreadPool::push(MyTask task, Priority priority) {
+    while(!tryPush(task, priority)) {
+        // only a bounded queue gets here
+        uint64_t key = not_full_.prepare_wait();
+        if(count_.load() < CAPACITY_) {
+            not_full_.cancel_wait();
+            continue;
+        }
+        not_full_.wait(key);
+    }
 }
 
-void MyThreadPool::MyWorker::work() {
+bool MyThreadPool::pop(MyTask& task, std::chrono::nanoseconds& waited) {
+    const bool ELASTIC = MIN_THREADS_ != MAX_THREADS_;
+    // whether this worker is counted in idle_
+    bool idle = false;
+    bool timed_out = false;
+    std::chrono::steady_clock::time_point deadline;
     while(true) {
+        bool taken = false;
         {
-            std::unique_lock<std::mutex> lock(worker_mtx_);
-            cv_.wait(lock, [this]() {return task_ != nullptr || stop_flag;});
-            // should i stop?
-            if(stop_flag) {
-                break;
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            size_t count = count_.load(std::memory_order_relaxed);
+            if(count != 0) {
+                const uint32_t AGING_LIMIT = aging_limit_.load(std::memory_order_relaxed);
+                // the most urgent non-empty level, unless some level has been passed over long enough. Of those the
+                // one passed over most often, on a tie the one whose oldest task has waited longest. The most urgent
+                // level competes as well, or with a limit of 0 it would never get a pick while others have tasks
+                Level* pick = nullptr;
+                Level* starved = nullptr;
+                for(Level& level : levels_) {
+                    if(level.size_ == 0) {
+                        continue;
+                    }
+                    if(!pick) {
+                        pick = &level;
+                    }
+                    if(level.passed_over_ >= AGING_LIMIT && (!starved || level.passed_over_ > starved->passed_over_ ||
+                        (level.passed_over_ == starved->passed_over_ &&
+                        level.ring_[level.head_].enqueued_ns_ < starved->ring_[starved->head_].enqueued_ns_))) {
+                        starved = &level;
+                    }
+                }
+                if(starved) {
+                    pick = starved;
+                }
+                // every other waiting level ages, a more urgent one too when a starved level gets the pick
+                for(Level& level : levels_) {
+                    if(&level != pick && level.size_ != 0) {
+                        ++level.passed_over_;
+                    }
+                }
+                pick->passed_over_ = 0;
+                Queued& head = pick->ring_[pick->head_];
+                task = std::move(head.task_);
+                waited = std::chrono::nanoseconds(std::max<int64_t>(nowNs() - head.enqueued_ns_, 0));
+                pick->head_ = (pick->head_ + 1) % pick->ring_.size();
+                --pick->size_;
+                pick->stats_.tasks_ += 1;
+                pick->stats_.total_wait_ += waited;
+                pick->stats_.max_wait_ = std::max(pick->stats_.max_wait_, waited);
+                // seq_cst, pairs with the registration in not_full_.prepare_wait()
+                count_.store(count - 1);
+                taken = true;
+                if(idle) {
+                    idle_.fetch_sub(1);
+                }
+            } else if(exit_signals_.load(std::memory_order_relaxed) != 0) {
+                // only once the real tasks are all gone
+                exit_signals_.fetch_sub(1);
+                live_.fetch_sub(1);
+                if(idle) {
+                    idle_.fetch_sub(1);
+                }
+                return false;
+            } else if(timed_out && live_.load(std::memory_order_relaxed) > MIN_THREADS_) {
+                // under the lock, so no submit counts on us once we are gone
+                idle_.fetch_sub(1);
+                live_.fetch_sub(1);
+                retired_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                if(!idle) {
+                    idle_.fetch_add(1);
+                    idle = true;
+                }
+                if(ELASTIC && (timed_out || deadline == std::chrono::steady_clock::time_point())) {
+                    // the first wait, or we are needed to keep MIN workers: idle for another period
+                    deadline = std::chrono::steady_clock::now() + IDLE_TIMEOUT_;
+                    timed_out = false;
+                }
             }
         }
-        // execute the task after free lock
-        task_();
-        {
-            std::lock_guard<std::mutex> lock(worker_mtx_);
-            // notify the thread pool
-            belongs_to_->report_finish(id_);
-            // reset the task
-            task_ = nullptr;
+        if(taken) {
+            if(CAPACITY_ != 0) {
+                not_full_.notify_one();
+            }
+            return true;
+        }
+        uint64_t key = not_empty_.prepare_wait();
+        // re-check after registration, a push before it may have skipped the notification
+        if(count_.load() != 0 || exit_signals_.load() != 0) {
+            not_empty_.cancel_wait();
+            continue;
+        }
+        if(ELASTIC) {
+            timed_out = !not_empty_.wait_until(key, deadline);
+        } else {
+            not_empty_.wait(key);
         }
     }
-    // can only reach here when stop_flag is true, and now, syncStop must be waiting for task_==nullptr
-    cv_.notify_one();
 }
 
-void MyThreadPool::MyWorker::acceptTask(std::function<void()> task) {
-    {
-        // Do i really need to acquired the lock here? I think this lock is already obtainable
-        std::lock_guard<std::mutex> lock(worker_mtx_);
-        assert(task_ == nullptr);
-        task_ = task;
+void MyThreadPool::post(MyTask task, Priority priority) {
+    if(!task) {
+        throw std::invalid_argument("empty task");
+    }
+    if(priority < URGENT || priority >= PRIORITY_NUM) {
+        throw std::invalid_argument("no such priority");
+    }
+    if(!enterSubmit()) {
+        throw std::runtime_error("thead pool has been closed");
+    }
+    // blocks only when the queue is bounded and full
+    push(std::move(task), priority);
+    leaveSubmit();
+}
+
+bool MyThreadPool::try_post(MyTask task, Priority priority) {
+    if(!task) {
+        throw std::invalid_argument("empty task");
+    }
+    if(priority < URGENT || priority >= PRIORITY_NUM) {
+        throw std::invalid_argument("no such priority");
+    }
+    if(!enterSubmit()) {
+        throw std::runtime_error("thead pool has been closed");
     }
-    cv_.notify_one();
+    bool pushed = tryPush(task, priority);
+    leaveSubmit();
+    return pushed;
 }
 
-void MyThreadPool::MyWorker::syncStop() {
+void MyThreadPool::stopAll() {
+    if(stopped_.exchange(true)) {
+        // cannot stop twice
+        return;
+    }
+    // a submitter that passed its check before we set stopped_ must get its task in ahead of the exit signals
+    while(submitting_.load() != 0) {
+        std::this_thread::yield();
+    }
+    // nobody spawns from here on. Take over the threads, a worker retiring from now on leaves its entry to us
+    std::list<Worker> workers;
     {
-        std::lock_guard<std::mutex> lock(worker_mtx_);
-        stop_flag = true;
+        std::lock_guard<std::mutex> lock(workers_mtx_);
+        workers.swap(workers_);
     }
-    cv_.notify_one();
+    // one exit signal per live worker, taken only once the queue is empty so the real tasks are still run. A worker
+    // that retires meanwhile just leaves its signal unused
     {
-        std::unique_lock<std::mutex> lock(worker_mtx_);
-        cv_.wait(lock, [this]() {
-            return task_ == nullptr;
-        });
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        // seq_cst, pairs with the registration in not_empty_.prepare_wait()
+        exit_signals_.store(live_.load());
+    }
+    not_empty_.notify_all();
+    for(Worker& worker : workers) {
+        if(worker.thread_.joinable()) {
+            worker.thread_.join();
+        }
     }
 }
 
+size_t MyThreadPool::size() const {
+    return live_.load(std::memory_order_relaxed);
+}
+
+size_t MyThreadPool::pending() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t MyThreadPool::spawned_count() const {
+    return spawned_.load(std::memory_order_relaxed);
+}
+
+uint64_t MyThreadPool::retired_count() const {
+    return retired_.load(std::memory_order_relaxed);
+}
+
+std::vector<int> MyThreadPool::cpu_mapping() {
+    std::lock_guard<std::mutex> lock(workers_mtx_);
+    return cpu_of_slot_;
+}
+
+void MyThreadPool::set_aging_limit(uint32_t picks) {
+    aging_limit_.store(picks, std::memory_order_relaxed);
+}
+
+std::vector<MyThreadPool::LevelStats> MyThreadPool::wait_stats() {
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    std::vector<LevelStats> ret;
+    for(const Level& level : levels_) {
+        ret.push_back(level.stats_);
+    }
+    return ret;
+}
+
+MyPoolStats MyThreadPool::stats() const {
+    MyPoolStats ret;
+    for(int slot = 0; slot < MAX_THREADS_; ++slot) {
+        ret.workers_.push_back(counters_[slot].snapshot());
+    }
+    return ret;
+}
+
+void MyThreadPool::work(std::list<Worker>::iterator self) {
+    // slot_ was set before this thread started
+    MyWorkerCounters& counters = counters_[self->slot_];
+    MyTask task;
+    std::chrono::nanoseconds waited;
+    auto idle_since = std::chrono::steady_clock::now();
+    while(pop(task, waited)) {
+        auto start = std::chrono::steady_clock::now();
+        counters.idled(start - idle_since);
+        task();
+        task = MyTask();
+        idle_since = std::chrono::steady_clock::now();
+        counters.task_done(waited, idle_since - start);
+    }
+    counters.idled(std::chrono::steady_clock::now() - idle_since);
+    std::lock_guard<std::mutex> lock(workers_mtx_);
+    slot_used_[self->slot_] = false;
+    if(stopped_.load()) {
+        // stopAll() owns the entry now and joins us
+        return;
+    }
+    // retired while the pool goes on, nobody will join us. Nothing of the pool is touched after the unlock
+    self->thread_.detach();
+    workers_.erase(self);
+}
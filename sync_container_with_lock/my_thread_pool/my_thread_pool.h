@@ -4,49 +4,164 @@
 
 #ifndef MY_THREAD_POOL_H
 #define MY_THREAD_POOL_H
-#include <condition_variable>
-#include <functional>
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../../my_utility/my_cpu_topology.h"
+#include "../../my_utility/my_event_count.h"
+#include "../../my_utility/my_pool_stats.h"
+#include "../../my_utility/my_task.h"
 
+/**
+ * Between MIN and MAX workers pulling from one shared task queue:
+ *  - submit() only enqueues, it never waits for a worker to become idle. With a capacity the queue is bounded and
+ *    submit() blocks while it is full, try_post() fails instead;
+ *  - tasks are MyTask, stored by value in a ring buffer that only grows, so a small callable costs no allocation at
+ *    all with post() and only the future's shared state with submit();
+ *  - idle workers sleep on an EventCount, a submit pays for a wakeup only when somebody sleeps;
+ *  - MIN workers start with the pool. Another one is spawned when a submit leaves more queued tasks than idle
+ *    workers, up to MAX, and a worker above MIN that has been idle for the idle timeout exits;
+ *  - every task has a priority, URGENT to BULK, one FIFO per level. A worker takes from the most urgent non-empty
+ *    level, except that once levels have been passed over aging limit picks in a row while they had tasks, the most
+ *    passed over of them gets the next one (on a tie the one with the oldest task). Each other level gets at most one
+ *    pick before a level that reached the limit, so a level with tasks is passed over at most limit +
+ *    PRIORITY_NUM - 1 times in a row: under a flood of URGENT work BULK is delayed but never starved. The time each
+ *    task spent queued is summed up per level, see wait_stats();
+ *  - stopAll() refuses new tasks, lets the workers finish what is already queued and joins them.
+ * Each worker takes the lowest free slot in [0, MAX), an affinity policy pins the worker of slot i to cpu_mapping()[i].
+ * The worker of a slot also keeps that slot's counters for stats(), a worker spawned later into a freed slot carries
+ * on with them.
+ */
 class MyThreadPool {
 public:
-    MyThreadPool(int pool_size);
+    enum Priority { URGENT, HIGH, NORMAL, BULK, PRIORITY_NUM };
+
+    // queue wait of the tasks of one level that workers have picked up so far
+    struct LevelStats {
+        uint64_t tasks_ = 0;
+        std::chrono::nanoseconds total_wait_{0};
+        std::chrono::nanoseconds max_wait_{0};
+
+        std::chrono::nanoseconds mean_wait() const {
+            return tasks_ ? total_wait_ / static_cast<int64_t>(tasks_) : std::chrono::nanoseconds(0);
+        }
+    };
+
+    // a fixed size pool, capacity 0 means an unbounded queue
+    explicit MyThreadPool(int pool_size, size_t capacity = 0, const MyAffinityPolicy& affinity = MyAffinityPolicy());
+    // an elastic pool of min_threads to max_threads workers
+    MyThreadPool(int min_threads, int max_threads, std::chrono::milliseconds idle_timeout, size_t capacity = 0,
+        const MyAffinityPolicy& affinity = MyAffinityPolicy());
     ~MyThreadPool();
     MyThreadPool(const MyThreadPool&) = delete;
     MyThreadPool& operator=(const MyThreadPool&) = delete;
 
-    void submit(std::function<void()>);
+    // run func on a worker, its result or exception comes back through the future. Throws std::runtime_error once
+    // the pool is stopped
+    template <typename F>
+    auto submit(F&& func, Priority priority = NORMAL) -> std::future<std::invoke_result_t<std::decay_t<F>&>> {
+        using R = std::invoke_result_t<std::decay_t<F>&>;
+        // the callable goes into the shared state, the task itself only holds the packaged_task
+        std::packaged_task<R()> task(std::forward<F>(func));
+        std::future<R> ft = task.get_future();
+        post(std::move(task), priority);
+        return ft;
+    }
+
+    // fire and forget, nothing is allocated for a callable that fits MyTask inline. func must not throw, as with
+    // std::thread. Throws std::runtime_error once the pool is stopped
+    void post(MyTask task, Priority priority = NORMAL);
+    // post, but false instead of waiting if the queue is full
+    bool try_post(MyTask task, Priority priority = NORMAL);
     void stopAll();
-    void syncStop(int);
+    // workers alive right now
     size_t size() const;
+    // tasks queued but not picked up yet
+    size_t pending() const;
+    // workers started and workers retired for being idle, over the lifetime of the pool
+    uint64_t spawned_count() const;
+    uint64_t retired_count() const;
+    // the CPU each worker slot is pinned to, -1 where it is not pinned (no policy, or the kernel refused)
+    std::vector<int> cpu_mapping();
+    // how many picks in a row a waiting level may be passed over before it competes for the next one, 16 unless set.
+    // 0 is round robin among the non-empty levels
+    void set_aging_limit(uint32_t picks);
+    // how long tasks waited in the queue, indexed by Priority
+    std::vector<LevelStats> wait_stats();
+    // per worker slot, all MAX of them: tasks run, time running them and time waiting in pop, wait and run time
+    // histograms. Read without stopping the workers
+    MyPoolStats stats() const;
 private:
-    struct MyWorker {
-        int id_;
-        MyWorker(int id, MyThreadPool* owner): id_(id), belongs_to_(owner), task_(nullptr), stop_flag(false) {}
-        // MyWorker(const MyWorker& mw): id_(mw.id_), belongs_to_(mw.belongs_to_), task_(mw.task_), stop_flag(mw.stop_flag){}
-        MyWorker(const MyWorker&) = delete;
-        MyWorker& operator=(const MyWorker&) = delete;
-
-        // optionally delete move as well if you want to be strict
-        MyWorker(MyWorker&&) = delete;
-        MyWorker& operator=(MyWorker&&) = delete;
-        void work();
-        void acceptTask(std::function<void()>);
-        void syncStop();
-    private:
-        MyThreadPool* belongs_to_;
-        std::function<void()> task_;
-        std::condition_variable cv_;
-        std::mutex worker_mtx_;
-        bool stop_flag;
+    struct Worker {
+        std::thread thread_;
+        int slot_;
     };
-    void report_finish(int);
-    const int POOL_SIZE_;
-    std::condition_variable cv_;
-    std::mutex mtx_;
-    std::queue<int> available_workers_;
-    std::vector<std::unique_ptr<MyWorker>> workers_;
-    bool stopped_;
+
+    struct Queued {
+        MyTask task_;
+        // steady_clock, in nanoseconds
+        int64_t enqueued_ns_;
+    };
+
+    // one FIFO per priority, items live in ring_[head_], ring_[head_ + 1], ... (mod the size), it doubles when full
+    struct Level {
+        std::vector<Queued> ring_;
+        size_t head_ = 0;
+        size_t size_ = 0;
+        // picks that went to a more urgent level while this one had tasks, since its last pick
+        uint32_t passed_over_ = 0;
+        LevelStats stats_;
+    };
+
+    // registers a submitter, false if the pool is stopped
+    bool enterSubmit();
+    void leaveSubmit();
+    bool tryPush(MyTask& task, Priority priority);
+    void push(MyTask task, Priority priority);
+    // false when the worker should exit, waited is how long the task was queued
+    bool pop(MyTask& task, std::chrono::nanoseconds& waited);
+    // live_ already counts the new worker
+    void spawnWorker();
+    void work(std::list<Worker>::iterator self);
+
+    const int MIN_THREADS_;
+    const int MAX_THREADS_;
+    const std::chrono::milliseconds IDLE_TIMEOUT_;
+    const size_t CAPACITY_;
+    std::mutex queue_mtx_;
+    Level levels_[PRIORITY_NUM];
+    // all levels together. Written under queue_mtx_, read without it to decide whether to sleep
+    std::atomic<size_t> count_;
+    // workers still to exit, taken only once every level is empty. Same rules as count_
+    std::atomic<int> exit_signals_;
+    std::atomic<uint32_t> aging_limit_;
+    // workers sleep here while the queue is empty
+    EventCount not_empty_;
+    // submitters sleep here while a bounded queue is full
+    EventCount not_full_;
+    // both only change under queue_mtx_, so a submit and a retiring worker agree on them
+    std::atomic<int> live_;
+    std::atomic<int> idle_;
+    std::mutex workers_mtx_;
+    // a worker retiring on its own detaches and erases its thread, stopAll() joins the rest
+    std::list<Worker> workers_;
+    // by slot, both under workers_mtx_
+    std::vector<bool> slot_used_;
+    std::vector<int> cpu_of_slot_;
+    // by slot, written only by the worker in the slot
+    std::unique_ptr<MyWorkerCounters[]> counters_;
+    std::atomic<uint64_t> spawned_;
+    std::atomic<uint64_t> retired_;
+    std::atomic<bool> stopped_;
+    // submitters between their check of stopped_ and their push, stopAll() waits for them before the exit signals
+    std::atomic<int> submitting_;
 };
 
 
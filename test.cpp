@@ -6,6 +6,9 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cmath>
+#include <fstream>
+#include <functional>
 #include <future>
 #include <iostream>
 #include <list>
@@ -13,6 +16,7 @@
 #include <map>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <shared_mutex>
 #include <vector>
 #include <stack>
@@ -29,9 +33,20 @@
 #include "my_utility/my_defer.h"
 #include "sync_container_lock_free/my_lock_free_queue/my_lock_free_queue.h"
 #include "multi_thread_algorithms/simple_algorithm.h"
+#include "multi_thread_algorithms/parallel_group_by.h"
 #include "my_thread_pool/thread_pool_demo01.h"
+#include "sync_container_with_lock/my_thread_pool/my_thread_pool.h"
+#include "sync_container_with_lock/my_thread_pool/my_task_graph.h"
 #include <semaphore>
 #include "my_utility/my_interruptible_thread.h"
+#include "sync_container_with_lock/my_sync_forward_list/my_sync_forward_list.h"
+#include "sync_container_with_lock/my_sync_forward_list/my_compact_forward_list.h"
+#include "sync_container_with_lock/my_sync_hash_map/my_sync_hash_map.h"
+#include "sync_container_with_lock/my_sync_hash_map/my_concurrent_lru_cache.h"
+#include "sync_container_with_lock/my_sync_hash_map/my_sync_flat_hash_map.h"
+#include "sync_container_lock_free/my_lock_free_hash_map/my_split_ordered_hash_map.h"
+#include "tests/my_check.h"
+#include <malloc.h>
 using namespace std;
 
 template<typename T>
@@ -159,7 +174,825 @@ void test2() {
     t3.join();
 }
 
-int main() {
-    test2();
-    return 0;
+template <typename List>
+void benchmark_one_list_layout(const char* name, int lookup_num) {
+    using Element = std::pair<int, int>;
+    // MySyncForwardList frees its nodes recursively, keep it well below the stack limit. 100000 overflowed 8 MB at -O0
+    constexpr int ELEMENT_NUM = 10000;
+    constexpr int BUCKET_LEN = 20;
+    {
+        size_t before = mallinfo2().uordblks;
+        auto lst = std::make_unique<List>();
+        for(int i = 0; i < ELEMENT_NUM; ++i) {
+            lst->push_front(Element(i, i));
+        }
+        size_t after = mallinfo2().uordblks;
+        cout << name << ": " << (after - before) / ELEMENT_NUM << " bytes per element\n";
+    }
+    // a typical hash bucket
+    List bucket;
+    for(int i = 0; i < BUCKET_LEN; ++i) {
+        bucket.insert_or_update([i](const Element& e) { return e.first == i; }, Element(i, i));
+    }
+    const int thread_num = std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<long> found(0);
+    std::atomic<long> sum(0);
+    auto start = chrono::steady_clock::now();
+    run_threads(thread_num, [&bucket, &found, &sum, thread_num, lookup_num](int t) {
+        long my_found = 0;
+        long my_sum = 0;
+        for(int i = t; i < lookup_num; i += thread_num) {
+            int key = i % BUCKET_LEN;
+            bucket.for_each_until([key, &my_found, &my_sum](const Element& e) {
+                if(e.first == key) {
+                    ++my_found;
+                    my_sum += e.second;
+                    return false;
+                }
+                return true;
+            });
+        }
+        found.fetch_add(my_found);
+        sum.fetch_add(my_sum);
+    });
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    // every lookup finds its key, whose value is the key
+    long expected = 0;
+    for(int i = 0; i < lookup_num; ++i) {
+        expected += i % BUCKET_LEN;
+    }
+    MY_CHECK(found.load() == lookup_num);
+    MY_CHECK(sum.load() == expected);
+    cout << name << ": " << lookup_num * 1000.0 / std::max<long long>(ms, 1) << " lookups/s with "
+         << thread_num << " threads\n";
+}
+
+void benchmark_forward_list_layout(int lookup_num = 1000000) {
+    benchmark_one_list_layout<MySyncForwardList<std::pair<int, int>>>("MySyncForwardList", lookup_num);
+    benchmark_one_list_layout<MyCompactForwardList<std::pair<int, int>>>("MyCompactForwardList", lookup_num);
+}
+
+template <typename Map>
+void benchmark_one_map_lookup(const char* name, int thread_num, int ops_per_thread = 200000) {
+    constexpr int KEY_NUM = 100000;
+    Map mp;
+    for(int i = 0; i < KEY_NUM; ++i) {
+        mp.insertOrUpdate(i, static_cast<long>(i));
+    }
+    // keys are only ever overwritten, a read that misses one is a bug
+    std::atomic<long> misses(0);
+    auto start = chrono::steady_clock::now();
+    run_threads(thread_num, [&mp, &misses, ops_per_thread](int t) {
+        MyXorShift rng(t);
+        for(int i = 0; i < ops_per_thread; ++i) {
+            uint64_t r = rng.next();
+            int key = static_cast<int>(r % KEY_NUM);
+            // 95% reads
+            if(r % 100 < 95) {
+                long val;
+                if(!mp.getValue(key, val)) {
+                    misses.fetch_add(1, std::memory_order_relaxed);
+                }
+            } else {
+                mp.insertOrUpdate(key, static_cast<long>(i));
+            }
+        }
+    });
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    MY_CHECK(misses.load() == 0);
+    MY_CHECK(mp.size() == KEY_NUM);
+    cout << name << ": " << static_cast<double>(ops_per_thread) * thread_num * 1000.0 / std::max<long long>(ms, 1)
+         << " ops/s with " << thread_num << " threads\n";
+}
+
+void benchmark_flat_hash_map(int thread_num = 16, int ops_per_thread = 200000) {
+    benchmark_one_map_lookup<MySyncHashMap<int, long>>("MySyncHashMap", thread_num, ops_per_thread);
+    benchmark_one_map_lookup<MySyncFlatHashMap<int, long>>("MySyncFlatHashMap", thread_num, ops_per_thread);
+}
+
+void benchmark_split_ordered_hash_map(int max_threads = 64, int ops_per_thread = 200000) {
+    for(int thread_num = 1; thread_num <= max_threads; thread_num *= 4) {
+        benchmark_one_map_lookup<MySyncHashMap<int, long>>("MySyncHashMap", thread_num, ops_per_thread);
+        benchmark_one_map_lookup<MySplitOrderedHashMap<int, long>>("MySplitOrderedHashMap", thread_num,
+            ops_per_thread);
+    }
+}
+
+void benchmark_multi_get(int key_num = 1 << 21, int rounds = 20000) {
+    constexpr int BATCH = 100;
+    MySyncHashMap<int, long> mp(key_num);
+    for(int i = 0; i < key_num; ++i) {
+        mp.insertOrUpdate(i, static_cast<long>(i));
+    }
+    std::vector<int> keys(BATCH);
+    std::vector<std::optional<long>> out;
+    MyXorShift rng(0);
+    // every key is there and holds itself, both ways have to find all of them
+    long one_by_one_found = 0;
+    long batched_found = 0;
+    chrono::steady_clock::duration one_by_one{}, batched{};
+    for(int r = 0; r < rounds; ++r) {
+        for(int& key : keys) {
+            key = static_cast<int>(rng.next() % key_num);
+        }
+        // both passes see fresh keys, the second pass would otherwise find them in cache
+        auto start = chrono::steady_clock::now();
+        for(int key : keys) {
+            long val;
+            if(mp.getValue(key, val) && val == key) {
+                ++one_by_one_found;
+            }
+        }
+        one_by_one += chrono::steady_clock::now() - start;
+        for(int& key : keys) {
+            key = (key + key_num / 2) % key_num;
+        }
+        start = chrono::steady_clock::now();
+        size_t found = mp.multi_get(keys, out);
+        batched += chrono::steady_clock::now() - start;
+        MY_CHECK(found == BATCH && out.size() == BATCH);
+        for(int i = 0; i < BATCH; ++i) {
+            batched_found += out[i] == static_cast<long>(keys[i]);
+        }
+    }
+    MY_CHECK(one_by_one_found == static_cast<long>(BATCH) * rounds);
+    MY_CHECK(batched_found == static_cast<long>(BATCH) * rounds);
+    cout << "getValue x" << BATCH << ": " << chrono::duration_cast<chrono::nanoseconds>(one_by_one).count() / rounds
+         << " ns, multi_get: " << chrono::duration_cast<chrono::nanoseconds>(batched).count() / rounds << " ns\n";
+}
+
+void benchmark_hot_key_counting(int thread_num = 8, int ops_per_thread = 500000) {
+    constexpr int KEY_NUM = 1000;
+    MySyncHashMap<int, long> counter;
+    auto start = chrono::steady_clock::now();
+    run_threads(thread_num, [&counter, ops_per_thread](int t) {
+        MyXorShift rng(t);
+        for(int i = 0; i < ops_per_thread; ++i) {
+            counter.upsert(static_cast<int>(rng.next() % KEY_NUM), [](long& cnt) { ++cnt; });
+        }
+    });
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    long total = 0;
+    for(int key = 0; key < KEY_NUM; ++key) {
+        long cnt = 0;
+        counter.getValue(key, cnt);
+        total += cnt;
+    }
+    // a lost increment means two upserts raced on one counter
+    MY_CHECK(total == static_cast<long>(ops_per_thread) * thread_num);
+    cout << "upsert: " << static_cast<double>(ops_per_thread) * thread_num * 1000.0 / std::max<long long>(ms, 1)
+         << " increments/s with " << thread_num << " threads, total " << total << "\n";
+}
+
+void benchmark_lru_cache(int thread_num = 32, int ops_per_thread = 200000) {
+    constexpr int HOT_KEY_NUM = 10000;
+    constexpr int COLD_KEY_NUM = 1000000;
+    constexpr size_t CAPACITY = 16384;
+    MyConcurrentLRUCache<int, long> cache(CAPACITY);
+    // every key is cached with itself as the value, a hit that returns anything else is a bug
+    std::atomic<long> wrong(0);
+    auto start = chrono::steady_clock::now();
+    run_threads(thread_num, [&cache, &wrong, ops_per_thread](int t) {
+        MyXorShift rng(t);
+        for(int i = 0; i < ops_per_thread; ++i) {
+            uint64_t r = rng.next();
+            // 97% of the requests go to a hot set that fits in the cache
+            int key = r % 100 < 97 ? static_cast<int>((r >> 8) % HOT_KEY_NUM)
+                                   : HOT_KEY_NUM + static_cast<int>((r >> 8) % COLD_KEY_NUM);
+            long val;
+            if(!cache.get(key, val)) {
+                cache.put(key, static_cast<long>(key));
+            } else if(val != key) {
+                wrong.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    auto stats = cache.stats();
+    MY_CHECK(wrong.load() == 0);
+    MY_CHECK(stats.hits_ + stats.misses_ == static_cast<uint64_t>(ops_per_thread) * thread_num);
+    MY_CHECK(cache.size() <= CAPACITY);
+    cout << "MyConcurrentLRUCache: " << static_cast<double>(ops_per_thread) * thread_num * 1000.0 /
+         std::max<long long>(ms, 1) << " ops/s with " << thread_num << " threads, hit rate "
+         << 100.0 * stats.hits_ / std::max<uint64_t>(stats.hits_ + stats.misses_, 1) << "%, "
+         << stats.evictions_ << " evictions\n";
+}
+
+void benchmark_frozen_hash_map(int key_num = 10000000, int lookup_num = 10000000) {
+    MySyncHashMap<int, long> mp(key_num);
+    for(int i = 0; i < key_num; ++i) {
+        mp.insertOrUpdate(i, static_cast<long>(i));
+    }
+    auto start = chrono::steady_clock::now();
+    auto frozen = mp.freeze();
+    cout << "freeze " << key_num << " keys: "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms\n";
+    MY_CHECK(frozen.size() == static_cast<size_t>(key_num));
+    // the same keys on both maps, every one of them there and holding itself
+    auto run = [key_num, lookup_num](const char* name, auto& map) {
+        MyXorShift rng(0);
+        long found = 0;
+        auto start = chrono::steady_clock::now();
+        for(int i = 0; i < lookup_num; ++i) {
+            int key = static_cast<int>(rng.next() % key_num);
+            long val;
+            if(map.getValue(key, val) && val == key) {
+                ++found;
+            }
+        }
+        auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        MY_CHECK(found == lookup_num);
+        cout << name << ": " << lookup_num * 1000.0 / std::max<long long>(ms, 1) << " lookups/s\n";
+    };
+    run("MySyncHashMap", mp);
+    run("MyFrozenHashMap", frozen);
+    // a key that was never inserted must miss, not land on some other key's slot
+    long val;
+    MY_CHECK(!frozen.getValue(key_num, val) && !frozen.getValue(-1, val));
+}
+
+void benchmark_hash_map_warm_load(int key_num = 10000000, const char* path = "/tmp/my_sync_hash_map.bin") {
+    auto elapsed_ms = [](auto start) {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    };
+    {
+        MySyncHashMap<int, long> mp(key_num);
+        auto start = chrono::steady_clock::now();
+        for(int i = 0; i < key_num; ++i) {
+            mp.insertOrUpdate(i, static_cast<long>(i));
+        }
+        cout << "populate " << key_num << " keys through insertOrUpdate: " << elapsed_ms(start) << " ms\n";
+        start = chrono::steady_clock::now();
+        mp.save(path);
+        cout << "save: " << elapsed_ms(start) << " ms\n";
+    }
+    for(bool promote : {false, true}) {
+        MySyncHashMap<int, long> mp;
+        auto start = chrono::steady_clock::now();
+        mp.load_mmap(path, promote);
+        long val = 0;
+        MY_CHECK(mp.getValue(key_num / 2, val) && val == key_num / 2);
+        cout << "load_mmap" << (promote ? " + promotion" : "") << " to first lookup: "
+             << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() << " us\n";
+        start = chrono::steady_clock::now();
+        long sum = 0;
+        for(int i = 0; i < key_num; ++i) {
+            if(mp.getValue(i, val)) {
+                sum += val;
+            }
+        }
+        cout << "  every key once: " << elapsed_ms(start) << " ms, sum " << sum << "\n";
+        MY_CHECK(sum == static_cast<long>(key_num) * (key_num - 1) / 2);
+        if(promote) {
+            while(mp.hasBase()) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+            cout << "  promoted after " << elapsed_ms(start) << " ms\n";
+        }
+        MY_CHECK(mp.size() == static_cast<size_t>(key_num));
+    }
+    std::remove(path);
+}
+
+void benchmark_group_by(int row_num = 20000000, int key_num = 1000000) {
+    // half of the rows hit 1000 hot keys, the rest spread over all keys
+    std::vector<std::pair<int, long>> rows(row_num);
+    MyXorShift rng(0);
+    for(auto& [key, value] : rows) {
+        uint64_t r = rng.next();
+        key = static_cast<int>((r & 1) ? (r >> 8) % 1000 : (r >> 8) % key_num);
+        value = static_cast<long>(r >> 40);
+    }
+    ThreadPoolDemo01 pool;
+    constexpr int CHUNK = 1 << 14;
+    auto start = chrono::steady_clock::now();
+    MySyncHashMap<int, long> shared_map(key_num);
+    std::vector<std::future<void>> futures;
+    for(int begin = 0; begin < row_num; begin += CHUNK) {
+        futures.push_back(pool.submit([&rows, &shared_map, begin, row_num]() {
+            for(int i = begin; i < std::min(begin + CHUNK, row_num); ++i) {
+                long value = rows[i].second;
+                shared_map.upsert(rows[i].first, [value](long& sum) { sum += value; });
+            }
+        }));
+    }
+    for(auto& ft : futures) {
+        ft.get();
+    }
+    auto shared_ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    ParallelGroupBy<int, long, SumAggregate<long>> group_by(pool);
+    auto result = group_by.run(rows);
+    auto engine_ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    bool same = result.size() == shared_map.size();
+    for(const auto& [key, sum] : result) {
+        long expected = 0;
+        same = same && shared_map.getValue(key, expected) && expected == sum;
+    }
+    MY_CHECK(same);
+    cout << row_num << " rows, " << result.size() << " groups, same result: " << same << "\n";
+    cout << "MySyncHashMap::upsert from every thread: " << shared_ms << " ms\n";
+    cout << "ParallelGroupBy: " << engine_ms << " ms\n";
+
+    // a custom aggregate: the mean, as (sum, count) so that partial states merge
+    struct MeanAggregate {
+        using State = std::pair<long, long>;
+        State init() const { return {0, 0}; }
+        void update(State& state, long value) const { state.first += value; ++state.second; }
+        void merge(State& state, const State& other) const { state.first += other.first; state.second += other.second; }
+    };
+    start = chrono::steady_clock::now();
+    auto means = ParallelGroupBy<int, long, MeanAggregate>(pool).run(rows);
+    cout << "ParallelGroupBy with a mean: "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms\n";
+    // the same groups as the sums, every row counted once
+    MY_CHECK(means.size() == result.size());
+    long counted = 0;
+    for(const auto& [key, state] : means) {
+        long sum = 0;
+        MY_CHECK(shared_map.getValue(key, sum) && sum == state.first);
+        counted += state.second;
+    }
+    MY_CHECK(counted == row_num);
+}
+
+void benchmark_thread_pool_submit(int task_num = 10000, int pool_size = 4) {
+    MyThreadPool pool(pool_size);
+    std::atomic<int> done(0);
+    auto tiny_task = [&done]() {
+        // about a microsecond of work
+        volatile int sink = 0;
+        for(int j = 0; j < 300; ++j) {
+            sink = sink + j;
+        }
+        done.fetch_add(1, std::memory_order_relaxed);
+    };
+    long long max_ns = 0;
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < task_num; ++i) {
+        auto before = chrono::steady_clock::now();
+        pool.post(tiny_task);
+        max_ns = std::max<long long>(max_ns,
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - before).count());
+    }
+    auto submit_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    // a lost task hangs here, and the smoke test runs under a CTest timeout
+    while(done.load() < task_num) {
+        this_thread::yield();
+    }
+    auto total_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    MY_CHECK(done.load() == task_num);
+    cout << "burst of " << task_num << " tasks: post " << submit_ns / task_num << " ns on average, "
+         << max_ns / 1000 << " us at most, all done after " << total_us << " us\n";
+
+    // the same with a future per task
+    std::vector<std::future<int>> futures;
+    futures.reserve(task_num);
+    start = chrono::steady_clock::now();
+    for(int i = 0; i < task_num; ++i) {
+        futures.push_back(pool.submit([i]() { return i; }));
+    }
+    submit_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    // every future carries the value of its own task
+    for(int i = 0; i < task_num; ++i) {
+        MY_CHECK(futures[i].get() == i);
+    }
+    cout << "submit with a future: " << submit_ns / task_num << " ns on average\n";
+}
+
+// threads and resident memory of this process, from /proc/self/status
+static void print_threads_and_rss(const char* when) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.rfind("Threads:", 0) == 0 || line.rfind("VmRSS:", 0) == 0) {
+            cout << when << " " << line << "\n";
+        }
+    }
+}
+
+void benchmark_elastic_thread_pool(int pool_num = 40, int max_threads = 8) {
+    using namespace std::chrono_literals;
+    auto start = chrono::steady_clock::now();
+    {
+        std::vector<std::unique_ptr<MyThreadPool>> pools;
+        for(int i = 0; i < pool_num; ++i) {
+            pools.push_back(std::make_unique<MyThreadPool>(max_threads));
+        }
+        cout << pool_num << " fixed pools of " << max_threads << " started in "
+             << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() << " us\n";
+        print_threads_and_rss("  idle:");
+    }
+    start = chrono::steady_clock::now();
+    std::vector<std::unique_ptr<MyThreadPool>> pools;
+    for(int i = 0; i < pool_num; ++i) {
+        pools.push_back(std::make_unique<MyThreadPool>(0, max_threads, 100ms));
+    }
+    cout << pool_num << " elastic pools of 0 to " << max_threads << " started in "
+         << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() << " us\n";
+    print_threads_and_rss("  idle:");
+    // no work, no thread
+    for(auto& pool : pools) {
+        MY_CHECK(pool->spawned_count() == 0);
+    }
+    std::atomic<int> done(0);
+    for(auto& pool : pools) {
+        for(int i = 0; i < 100; ++i) {
+            pool->post([&done]() {
+                this_thread::sleep_for(1ms);
+                done.fetch_add(1);
+            });
+        }
+    }
+    print_threads_and_rss("  burst:");
+    while(done.load() != pool_num * 100) {
+        this_thread::sleep_for(1ms);
+    }
+    this_thread::sleep_for(300ms);
+    print_threads_and_rss("  300 ms after:");
+    MY_CHECK(done.load() == pool_num * 100);
+    uint64_t spawned = 0;
+    uint64_t retired = 0;
+    for(auto& pool : pools) {
+        // the burst needed a worker, and 300 ms is three idle timeouts, every one of them retired
+        MY_CHECK(pool->spawned_count() >= 1);
+        MY_CHECK(pool->size() == 0 && pool->retired_count() == pool->spawned_count());
+        spawned += pool->spawned_count();
+        retired += pool->retired_count();
+    }
+    cout << "  spawned " << spawned << ", retired " << retired << "\n";
+}
+
+void test_thread_pool_affinity(int pool_size = 4) {
+    MyCpuTopology topology;
+    cout << "usable CPUs:";
+    for(const auto& cpu : topology.cpus()) {
+        cout << " " << cpu.cpu_ << "(socket " << cpu.package_ << ", core " << cpu.core_ << ")";
+    }
+    cout << "\n";
+    MY_CHECK(!topology.cpus().empty());
+    // a slot is pinned to a CPU we may run on, or not at all
+    auto valid_slot = [&topology](int cpu) {
+        return cpu == -1 || std::any_of(topology.cpus().begin(), topology.cpus().end(),
+            [cpu](const auto& usable) { return usable.cpu_ == cpu; });
+    };
+    std::pair<const char*, MyAffinityPolicy> policies[] = {
+        {"none", MyAffinityPolicy()},
+        {"compact", MyAffinityPolicy::compact()},
+        {"scatter", MyAffinityPolicy::scatter()},
+        {"explicit 0,1", MyAffinityPolicy::explicit_cpus({0, 1})},
+    };
+    for(const auto& [name, policy] : policies) {
+        MyThreadPool pool(pool_size, 0, policy);
+        // a copy, taken under the pool's lock
+        const std::vector<int> mapping = pool.cpu_mapping();
+        MY_CHECK(mapping.size() == static_cast<size_t>(pool_size));
+        MY_CHECK(std::all_of(mapping.begin(), mapping.end(), valid_slot));
+        if(policy.kind_ == MyAffinityPolicy::NONE) {
+            MY_CHECK(std::count(mapping.begin(), mapping.end(), -1) == pool_size);
+        }
+        std::vector<std::future<int>> ran_on;
+        for(int i = 0; i < pool_size * 4; ++i) {
+            ran_on.push_back(pool.submit([]() { return sched_getcpu(); }));
+        }
+        cout << name << ": slots pinned to";
+        for(int cpu : pool.cpu_mapping()) {
+            cout << " " << cpu;
+        }
+        cout << ", tasks ran on";
+        // with every slot pinned, no task may run anywhere else
+        const bool all_pinned = std::count(mapping.begin(), mapping.end(), -1) == 0;
+        for(auto& ft : ran_on) {
+            int cpu = ft.get();
+            MY_CHECK(cpu >= 0);
+            MY_CHECK(!all_pinned || std::count(mapping.begin(), mapping.end(), cpu) != 0);
+            cout << " " << cpu;
+        }
+        cout << "\n";
+    }
+    ThreadPoolDemo01 demo(MyAffinityPolicy::scatter());
+    MY_CHECK(std::all_of(demo.cpu_mapping().begin(), demo.cpu_mapping().end(), valid_slot));
+    cout << "ThreadPoolDemo01 scatter:";
+    for(int cpu : demo.cpu_mapping()) {
+        cout << " " << cpu;
+    }
+    cout << "\n";
+}
+
+// interactive tasks arriving while the pool chews through a batch backlog: once in the same level as the batch
+// (plain FIFO), once as URGENT over BULK
+void benchmark_thread_pool_priority(int batch_num = 4000, int interactive_num = 100, int pool_size = 2) {
+    using namespace std::chrono_literals;
+    auto spin = [](chrono::microseconds length) {
+        auto until = chrono::steady_clock::now() + length;
+        while(chrono::steady_clock::now() < until) {}
+    };
+    std::pair<const char*, std::pair<MyThreadPool::Priority, MyThreadPool::Priority>> runs[] = {
+        {"fifo", {MyThreadPool::NORMAL, MyThreadPool::NORMAL}},
+        {"urgent over bulk", {MyThreadPool::URGENT, MyThreadPool::BULK}},
+    };
+    std::vector<int64_t> p50s;
+    for(const auto& [name, priorities] : runs) {
+        MyThreadPool pool(pool_size);
+        for(int i = 0; i < batch_num; ++i) {
+            pool.post([spin]() { spin(200us); }, priorities.second);
+        }
+        std::vector<std::future<chrono::nanoseconds>> delays;
+        for(int i = 0; i < interactive_num; ++i) {
+            auto posted = chrono::steady_clock::now();
+            delays.push_back(pool.submit([posted]() { return chrono::steady_clock::now() - posted; },
+                priorities.first));
+            this_thread::sleep_for(2ms);
+        }
+        std::vector<int64_t> us;
+        for(auto& ft : delays) {
+            us.push_back(chrono::duration_cast<chrono::microseconds>(ft.get()).count());
+        }
+        std::sort(us.begin(), us.end());
+        pool.stopAll();
+        cout << name << ": interactive start delay p50 " << us[us.size() / 2] << " us, p99 "
+             << us[us.size() * 99 / 100] << " us\n";
+        p50s.push_back(us[us.size() / 2]);
+        const char* level_names[] = {"urgent", "high", "normal", "bulk"};
+        auto stats = pool.wait_stats();
+        uint64_t tasks = 0;
+        for(int p = 0; p < MyThreadPool::PRIORITY_NUM; ++p) {
+            tasks += stats[p].tasks_;
+        }
+        MY_CHECK(tasks == static_cast<uint64_t>(batch_num + interactive_num));
+        MY_CHECK(stats[priorities.first].tasks_ >= static_cast<uint64_t>(interactive_num));
+        for(int p = 0; p < MyThreadPool::PRIORITY_NUM; ++p) {
+            if(stats[p].tasks_ != 0) {
+                cout << "  " << level_names[p] << ": " << stats[p].tasks_ << " tasks, mean wait "
+                     << chrono::duration_cast<chrono::microseconds>(stats[p].mean_wait()).count() << " us, max "
+                     << chrono::duration_cast<chrono::microseconds>(stats[p].max_wait_).count() << " us\n";
+            }
+        }
+    }
+    // behind the whole backlog in fifo, ahead of it as urgent
+    MY_CHECK(p50s[1] < p50s[0]);
+}
+
+// 100k tiny nodes, as a binary tree (every node makes two ready) and as a grid where (r, c) waits for (r - 1, c) and
+// (r, c - 1), a wavefront. Build, first run (compiles the edges) and the runs after it, against the same number of
+// independent posts
+void benchmark_task_graph(int node_num = 100000, int pool_size = 4, int run_num = 10) {
+    auto us_since = [](chrono::steady_clock::time_point start) {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    };
+    MyThreadPool pool(pool_size);
+    std::atomic<int64_t> sum(0);
+    auto start = chrono::steady_clock::now();
+    std::atomic<int> done(0);
+    for(int i = 0; i < node_num; ++i) {
+        pool.post([&sum, &done, i]() {
+            sum.fetch_add(i, std::memory_order_relaxed);
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    while(done.load(std::memory_order_acquire) != node_num) {
+        this_thread::yield();
+    }
+    cout << node_num << " independent posts: " << us_since(start) << " us\n";
+    MY_CHECK(sum.load() == int64_t(node_num) * (node_num - 1) / 2);
+
+    const int SIDE = static_cast<int>(std::sqrt(node_num));
+    struct Shape {
+        const char* name_;
+        int node_num_;
+        std::function<void(TaskGraph&)> connect_;
+    };
+    Shape shapes[] = {
+        {"binary tree", node_num, [node_num](TaskGraph& graph) {
+            for(int i = 1; i < node_num; ++i) {
+                graph.precede((i - 1) / 2, i);
+            }
+        }},
+        {"wavefront", SIDE * SIDE, [SIDE](TaskGraph& graph) {
+            for(int r = 0; r < SIDE; ++r) {
+                for(int c = 0; c < SIDE; ++c) {
+                    if(r > 0) {
+                        graph.precede((r - 1) * SIDE + c, r * SIDE + c);
+                    }
+                    if(c > 0) {
+                        graph.precede(r * SIDE + c - 1, r * SIDE + c);
+                    }
+                }
+            }
+        }},
+    };
+    for(auto& [name, num, connect] : shapes) {
+        sum.store(0);
+        start = chrono::steady_clock::now();
+        TaskGraph graph;
+        for(int i = 0; i < num; ++i) {
+            graph.add([&sum, i]() { sum.fetch_add(i, std::memory_order_relaxed); });
+        }
+        connect(graph);
+        auto built = us_since(start);
+        start = chrono::steady_clock::now();
+        graph.run(pool);
+        auto first = us_since(start);
+        start = chrono::steady_clock::now();
+        for(int i = 0; i < run_num; ++i) {
+            graph.run(pool);
+        }
+        auto again = us_since(start) / run_num;
+        cout << name << ", " << graph.size() << " nodes " << graph.edge_num() << " edges: build " << built
+             << " us, first run " << first << " us, run again " << again << " us\n";
+        // every node once per run
+        MY_CHECK(sum.load() == int64_t(num) * (num - 1) / 2 * (run_num + 1));
+    }
+}
+
+// every task counted once, in both histograms
+static void check_pool_stats(const MyPoolStats& stats, uint64_t task_num) {
+    MyWorkerStats total = stats.total();
+    MY_CHECK(total.tasks_ == task_num);
+    MY_CHECK(total.wait_.count() == task_num && total.run_.count() == task_num);
+    MY_CHECK(total.steals_ <= total.steal_attempts_);
+    MY_CHECK(total.utilization() >= 0.0 && total.utilization() <= 1.0);
+}
+
+static void print_pool_stats(const char* name, const MyPoolStats& stats) {
+    auto us = [](chrono::nanoseconds ns) { return chrono::duration_cast<chrono::microseconds>(ns).count(); };
+    MyWorkerStats total = stats.total();
+    cout << name << ": " << total.tasks_ << " tasks, utilization " << total.utilization() << ", steals "
+         << total.steals_ << "/" << total.steal_attempts_ << ", wait p50 " << us(total.wait_.percentile(0.5))
+         << " us p99 " << us(total.wait_.percentile(0.99)) << " us, run p50 " << us(total.run_.percentile(0.5))
+         << " us p99 " << us(total.run_.percentile(0.99)) << " us\n  tasks per worker:";
+    for(const MyWorkerStats& worker : stats.workers_) {
+        cout << " " << worker.tasks_;
+    }
+    cout << "\n";
+}
+
+// the same load of short tasks on both pools, then what stats() says about it
+void benchmark_pool_stats(int task_num = 20000, int pool_size = 4) {
+    using namespace std::chrono_literals;
+    auto spin = [](chrono::microseconds length) {
+        auto until = chrono::steady_clock::now() + length;
+        while(chrono::steady_clock::now() < until) {}
+    };
+    {
+        MyThreadPool pool(pool_size);
+        auto start = chrono::steady_clock::now();
+        for(int i = 0; i < task_num; ++i) {
+            pool.post([spin]() { spin(20us); });
+        }
+        auto post_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        pool.stopAll();
+        cout << "MyThreadPool post " << post_ns / task_num << " ns on average\n";
+        MyPoolStats stats = pool.stats();
+        print_pool_stats("MyThreadPool", stats);
+        check_pool_stats(stats, task_num);
+    }
+    {
+        ThreadPoolDemo01 pool;
+        std::vector<std::future<void>> futures;
+        futures.reserve(task_num);
+        for(int i = 0; i < task_num; ++i) {
+            futures.push_back(pool.submit([spin]() { spin(20us); }));
+        }
+        for(auto& ft : futures) {
+            ft.get();
+        }
+        MyPoolStats stats = pool.stats();
+        print_pool_stats("ThreadPoolDemo01", stats);
+        check_pool_stats(stats, task_num);
+    }
+}
+
+// wait for a child task the way fork-join code has to on a fixed pool: run other tasks meanwhile, never block. Only
+// from a worker, it pops its own children first. An outside thread helping would steal the biggest tasks and nest
+// them without bound
+template <typename R>
+static R join_helping(ThreadPoolDemo01& pool, std::future<R>& ft) {
+    while(ft.wait_for(chrono::seconds(0)) != std::future_status::ready) {
+        pool.run_pending_task();
+    }
+    return ft.get();
+}
+
+static long fib_sequential(int n) {
+    return n < 2 ? n : fib_sequential(n - 1) + fib_sequential(n - 2);
+}
+
+// one task per call above cutoff
+static long fib_fork_join(ThreadPoolDemo01& pool, int n, int cutoff) {
+    if(n <= cutoff) {
+        return fib_sequential(n);
+    }
+    auto left = pool.submit([&pool, n, cutoff]() { return fib_fork_join(pool, n - 1, cutoff); });
+    long right = fib_fork_join(pool, n - 2, cutoff);
+    return join_helping(pool, left) + right;
+}
+
+static void quick_sort_fork_join(ThreadPoolDemo01& pool, int* first, int* last, ptrdiff_t cutoff) {
+    if(last - first <= cutoff) {
+        std::sort(first, last);
+        return;
+    }
+    int pivot = first[(last - first) / 2];
+    int* middle1 = std::partition(first, last, [pivot](int x) { return x < pivot; });
+    int* middle2 = std::partition(middle1, last, [pivot](int x) { return x == pivot; });
+    auto left = pool.submit([&pool, first, middle1, cutoff]() {
+        quick_sort_fork_join(pool, first, middle1, cutoff);
+    });
+    quick_sort_fork_join(pool, middle2, last, cutoff);
+    join_helping(pool, left);
+}
+
+// fork-join on ThreadPoolDemo01, every task spawned by a worker goes through its work-stealing deque. The root runs as
+// a task too, the calling thread just blocks on it
+void benchmark_work_stealing(int fib_n = 35, int fib_cutoff = 12, int sort_size = 10000000, int sort_cutoff = 4096) {
+    auto ms_since = [](chrono::steady_clock::time_point start) {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    };
+    auto start = chrono::steady_clock::now();
+    long expected = fib_sequential(fib_n);
+    cout << "fib(" << fib_n << ") sequential: " << ms_since(start) << " ms\n";
+    std::vector<int> nums(sort_size);
+    std::mt19937 rng(42);
+    for(int& x : nums) {
+        x = static_cast<int>(rng());
+    }
+    std::vector<int> sorted = nums;
+    start = chrono::steady_clock::now();
+    std::sort(sorted.begin(), sorted.end());
+    cout << "sort of " << sort_size << " ints, std::sort: " << ms_since(start) << " ms\n";
+
+    ThreadPoolDemo01 pool;
+    start = chrono::steady_clock::now();
+    long got = pool.submit([&pool, fib_n, fib_cutoff]() { return fib_fork_join(pool, fib_n, fib_cutoff); }).get();
+    cout << "fib(" << fib_n << ") fork-join, cutoff " << fib_cutoff << ": " << ms_since(start) << " ms\n";
+    MY_CHECK(got == expected);
+    start = chrono::steady_clock::now();
+    pool.submit([&pool, &nums, sort_cutoff]() {
+        quick_sort_fork_join(pool, nums.data(), nums.data() + nums.size(), sort_cutoff);
+    }).get();
+    cout << "parallel quicksort, cutoff " << sort_cutoff << ": " << ms_since(start) << " ms\n";
+    MY_CHECK(nums == sorted);
+    print_pool_stats("ThreadPoolDemo01", pool.stats());
+}
+
+// a benchmark by name, at the size its numbers are meant for, and at a small one that only runs its checks
+struct Benchmark {
+    const char* name_;
+    std::function<void()> full_;
+    std::function<void()> smoke_;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"forward_list_layout", []() { benchmark_forward_list_layout(); },
+        []() { benchmark_forward_list_layout(100000); }},
+    {"flat_hash_map", []() { benchmark_flat_hash_map(); }, []() { benchmark_flat_hash_map(4, 20000); }},
+    {"split_ordered_hash_map", []() { benchmark_split_ordered_hash_map(); },
+        []() { benchmark_split_ordered_hash_map(16, 5000); }},
+    {"multi_get", []() { benchmark_multi_get(); }, []() { benchmark_multi_get(1 << 16, 1000); }},
+    {"hot_key_counting", []() { benchmark_hot_key_counting(); }, []() { benchmark_hot_key_counting(4, 20000); }},
+    {"lru_cache", []() { benchmark_lru_cache(); }, []() { benchmark_lru_cache(8, 20000); }},
+    {"frozen_hash_map", []() { benchmark_frozen_hash_map(); }, []() { benchmark_frozen_hash_map(100000, 100000); }},
+    {"hash_map_warm_load", []() { benchmark_hash_map_warm_load(); },
+        []() { benchmark_hash_map_warm_load(100000, "/tmp/my_sync_hash_map_smoke.bin"); }},
+    {"group_by", []() { benchmark_group_by(); }, []() { benchmark_group_by(200000, 10000); }},
+    {"thread_pool_submit", []() { benchmark_thread_pool_submit(); }, []() { benchmark_thread_pool_submit(2000, 4); }},
+    {"elastic_thread_pool", []() { benchmark_elastic_thread_pool(); }, []() { benchmark_elastic_thread_pool(8, 4); }},
+    {"thread_pool_affinity", []() { test_thread_pool_affinity(); }, []() { test_thread_pool_affinity(); }},
+    {"thread_pool_priority", []() { benchmark_thread_pool_priority(); },
+        []() { benchmark_thread_pool_priority(400, 20); }},
+    {"task_graph", []() { benchmark_task_graph(); }, []() { benchmark_task_graph(10000, 4, 3); }},
+    {"pool_stats", []() { benchmark_pool_stats(); }, []() { benchmark_pool_stats(2000, 4); }},
+    {"work_stealing", []() { benchmark_work_stealing(); }, []() { benchmark_work_stealing(22, 8, 200000, 256); }},
+};
+
+// no argument runs the channel demo, a benchmark name runs that benchmark, "smoke" every benchmark at its small size.
+// A failed check aborts, so the exit code tells
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        test2();
+        return 0;
+    }
+    const std::string what = argv[1];
+    if(what == "smoke") {
+        for(const Benchmark& benchmark : BENCHMARKS) {
+            cout << "== " << benchmark.name_ << "\n";
+            benchmark.smoke_();
+        }
+        return 0;
+    }
+    for(const Benchmark& benchmark : BENCHMARKS) {
+        if(what == benchmark.name_) {
+            benchmark.full_();
+            return 0;
+        }
+    }
+    cerr << "unknown benchmark " << what << ", one of: smoke";
+    for(const Benchmark& benchmark : BENCHMARKS) {
+        cerr << " " << benchmark.name_;
+    }
+    cerr << "\n";
+    return 1;
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_hash_map/my_sync_hash_map.h"
+
+static std::string temp_path(const char* name) {
+    return "/tmp/" + std::string(name) + "." + std::to_string(getpid()) + ".bin";
+}
+
+static std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+static uint64_t get_u64(const std::vector<char>& bytes, size_t offset) {
+    uint64_t value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+static void put_u64(std::vector<char>& bytes, size_t offset, uint64_t value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+// an int key and a long value leave 4 bytes of padding in every slot, the file must hold zeros there and nothing else
+static void check_save_is_reproducible() {
+    constexpr int KEY_NUM = 2000;
+    std::string first = temp_path("my_frozen_first");
+    std::string second = temp_path("my_frozen_second");
+    for(const std::string& path : {first, second}) {
+        // leave garbage on the heap for the slots to be built on, small enough to not come from fresh zeroed pages
+        std::vector<char> garbage(KEY_NUM * 16, static_cast<char>(0xAB));
+        garbage = std::vector<char>();
+        MySyncHashMap<int, long> map(64);
+        for(int key = 0; key < KEY_NUM; ++key) {
+            map.insertOrUpdate(key, key * 3L);
+        }
+        map.save(path);
+    }
+    std::vector<char> bytes = read_file(first);
+    MY_CHECK(!bytes.empty() && bytes == read_file(second));
+    // the slots are the end of the file, key at 0, padding at [4, 8), value at 8
+    struct Slot {
+        int key_;
+        long value_;
+    };
+    static_assert(sizeof(Slot) == 16);
+    const char* slots = bytes.data() + bytes.size() - KEY_NUM * sizeof(Slot);
+    for(int i = 0; i < KEY_NUM; ++i) {
+        const char* slot = slots + i * sizeof(Slot);
+        MY_CHECK(slot[4] == 0 && slot[5] == 0 && slot[6] == 0 && slot[7] == 0);
+        int key;
+        long value;
+        std::memcpy(&key, slot, sizeof(key));
+        std::memcpy(&value, slot + 8, sizeof(value));
+        MY_CHECK(value == key * 3L);
+    }
+
+    MySyncHashMap<int, long> loaded;
+    loaded.load_mmap(first);
+    MY_CHECK(loaded.size() == KEY_NUM);
+    for(int key = 0; key < KEY_NUM; ++key) {
+        long value = 0;
+        MY_CHECK(loaded.getValue(key, value) && value == key * 3L);
+    }
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+}
+
+/**
+ * for_each over a map with a base attached, while writers keep copying base-only keys into the chains (an upsert of
+ * a base key does) and the background promotion copies the rest. Every key is present the whole time, so every pass
+ * must see each of them exactly once.
+ */
+static void check_for_each_while_keys_leave_the_base() {
+    static constexpr int KEY_NUM = 50000;
+    constexpr int WRITER_NUM = 2;
+    std::string path = temp_path("my_frozen_for_each");
+    {
+        MySyncHashMap<int, long> map(1024);
+        for(int key = 0; key < KEY_NUM; ++key) {
+            map.insertOrUpdate(key, 0L);
+        }
+        map.save(path);
+    }
+    for(bool promote : {false, true}) {
+        MySyncHashMap<int, long> map;
+        map.load_mmap(path, promote);
+        std::atomic<int> writers_left{WRITER_NUM};
+        std::atomic<int> passes{0};
+        run_threads(WRITER_NUM + 1, [&](int t) {
+            if(t == WRITER_NUM) {
+                std::vector<int> seen(KEY_NUM);
+                while(writers_left.load(std::memory_order_acquire) > 0 || passes.load() < 2) {
+                    std::fill(seen.begin(), seen.end(), 0);
+                    map.for_each([&seen](int key, long value) {
+                        MY_CHECK(key >= 0 && key < KEY_NUM && value >= 0);
+                        ++seen[key];
+                    });
+                    for(int key = 0; key < KEY_NUM; ++key) {
+                        MY_CHECK(seen[key] == 1);
+                    }
+                    passes.fetch_add(1);
+                }
+                return;
+            }
+            MyXorShift rng(t);
+            for(int i = 0; i < KEY_NUM; ++i) {
+                map.upsert(static_cast<int>(rng.next() % KEY_NUM), [](long& value) { ++value; });
+            }
+            writers_left.fetch_sub(1, std::memory_order_release);
+        });
+        MY_CHECK(map.size() == KEY_NUM);
+    }
+    std::remove(path.c_str());
+}
+
+/**
+ * Files of the right size whose content would send a lookup outside the mapping: load_mmap() has to refuse them.
+ * The header is magic, slot size, slot num, position num and bucket num, 8 bytes each, the seeds start at 64.
+ */
+static void check_corrupt_files_are_rejected() {
+    constexpr int KEY_NUM = 2000;
+    constexpr size_t SLOT_NUM = 16, POSITION_NUM = 24, BUCKET_NUM = 32;
+    using Frozen = MyFrozenHashMap<int, long>;
+    std::string path = temp_path("my_frozen_corrupt");
+    {
+        MySyncHashMap<int, long> map;
+        for(int key = 0; key < KEY_NUM; ++key) {
+            map.insertOrUpdate(key, static_cast<long>(key));
+        }
+        map.freeze().save(path);
+    }
+    const std::vector<char> good = read_file(path);
+    auto rejected = [&path](const std::vector<char>& bytes) {
+        write_file(path, bytes);
+        try {
+            Frozen::load_mmap(path);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    MY_CHECK(!rejected(good));
+    MY_CHECK(Frozen::load_mmap(path).size() == KEY_NUM);
+
+    // truncated
+    MY_CHECK(rejected(std::vector<char>(good.begin(), good.end() - 16)));
+
+    // a remap entry beyond the slots
+    const uint64_t remap_num = get_u64(good, POSITION_NUM) - get_u64(good, SLOT_NUM);
+    MY_CHECK(remap_num > 0);
+    const size_t remap_offset = (64 + get_u64(good, BUCKET_NUM) * sizeof(uint32_t) + 63) / 64 * 64;
+    std::vector<char> bad = good;
+    put_u64(bad, remap_offset + (remap_num - 1) * sizeof(uint64_t), KEY_NUM);
+    MY_CHECK(rejected(bad));
+
+    // slots but no bucket: the seeds array is empty, the header alone still adds up to the file size
+    const uint64_t SLOTS = 4;
+    bad.assign(64 + SLOTS * 16, 0);
+    std::memcpy(bad.data(), good.data(), 16);
+    put_u64(bad, SLOT_NUM, SLOTS);
+    put_u64(bad, POSITION_NUM, SLOTS);
+    put_u64(bad, BUCKET_NUM, 0);
+    MY_CHECK(rejected(bad));
+
+    // 2^60 slots of 16 bytes wrap the file size around to the end of the seeds, 128 bytes
+    bad.assign(128, 0);
+    std::memcpy(bad.data(), good.data(), 16);
+    put_u64(bad, SLOT_NUM, uint64_t(1) << 60);
+    put_u64(bad, POSITION_NUM, uint64_t(1) << 60);
+    put_u64(bad, BUCKET_NUM, 1);
+    MY_CHECK(rejected(bad));
+    std::remove(path.c_str());
+}
+
+int main() {
+    check_save_is_reproducible();
+    check_corrupt_files_are_rejected();
+    check_for_each_while_keys_leave_the_base();
+    std::printf("check_frozen_hash_map passed\n");
+    return 0;
+}
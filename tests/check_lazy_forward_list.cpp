@@ -0,0 +1,99 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_forward_list/my_lazy_forward_list.h"
+
+// counts live instances, so the check can tell whether retired values and nodes are ever freed
+struct Entry {
+    static std::atomic<long> live_;
+    int key_;
+    // always key_ * 1000 + something below 1000, a reader looking at a freed or half built entry breaks that
+    long value_;
+
+    Entry(int key, long version): key_(key), value_(key * 1000L + version % 1000) {
+        live_.fetch_add(1, std::memory_order_relaxed);
+    }
+    Entry(const Entry& other): key_(other.key_), value_(other.value_) {
+        live_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~Entry() {
+        live_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    bool consistent() const {
+        return value_ / 1000 == key_;
+    }
+};
+std::atomic<long> Entry::live_{0};
+
+int main() {
+    constexpr int WRITER_NUM = 4;
+    constexpr int READER_NUM = 2;
+    constexpr int KEY_NUM = 256;
+    constexpr int OP_NUM = 30000;
+
+    // every writer owns the keys k with k % WRITER_NUM == t, so its own view of them is exact while all writers still
+    // fight over the same nodes and locks
+    std::vector<std::vector<char>> present(WRITER_NUM, std::vector<char>(KEY_NUM, 0));
+    std::atomic<int> writers_left{WRITER_NUM};
+    {
+        MyLazyForwardList<Entry> list;
+        run_threads(WRITER_NUM + READER_NUM, [&](int t) {
+            MyXorShift rng(t);
+            if(t >= WRITER_NUM) {
+                while(writers_left.load(std::memory_order_acquire) > 0) {
+                    list.for_each([](const Entry& entry) {
+                        MY_CHECK(entry.key_ >= 0 && entry.key_ < KEY_NUM);
+                        MY_CHECK(entry.consistent());
+                    });
+                }
+                return;
+            }
+            std::vector<char>& mine = present[t];
+            for(int i = 0; i < OP_NUM; ++i) {
+                uint64_t r = rng.next();
+                int key = static_cast<int>((r >> 8) % (KEY_NUM / WRITER_NUM)) * WRITER_NUM + t;
+                auto same_key = [key](const Entry& entry) { return entry.key_ == key; };
+                switch(r % 4) {
+                    case 0:
+                    case 1: {
+                        bool inserted = list.insert_or_update(same_key, Entry(key, i));
+                        MY_CHECK(inserted == !mine[key]);
+                        mine[key] = 1;
+                        break;
+                    }
+                    case 2: {
+                        bool removed = list.remove_first_if(same_key);
+                        MY_CHECK(removed == static_cast<bool>(mine[key]));
+                        mine[key] = 0;
+                        break;
+                    }
+                    default: {
+                        bool found = list.visit_first_if(same_key, [key](const Entry& entry) {
+                            MY_CHECK(entry.key_ == key && entry.consistent());
+                        });
+                        MY_CHECK(found == static_cast<bool>(mine[key]));
+                        break;
+                    }
+                }
+            }
+            writers_left.fetch_sub(1, std::memory_order_release);
+        });
+
+        // the final set is exactly what the writers think they left behind, every key once
+        std::vector<int> count(KEY_NUM, 0);
+        list.for_each([&count](const Entry& entry) { ++count[entry.key_]; });
+        for(int key = 0; key < KEY_NUM; ++key) {
+            MY_CHECK(count[key] == present[key % WRITER_NUM][key]);
+        }
+    }
+    // the writers exited with retired entries in their buffers, nobody reads anymore, one collect frees them all
+    EpochReclaimer::instance().collect();
+    MY_CHECK(Entry::live_.load() == 0);
+    std::printf("check_lazy_forward_list passed\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_lock_free/my_lock_free_list/my_lock_free_ordered_list.h"
+
+// counts live instances, so the checks can tell when a retired node is really deleted
+struct Tracked {
+    static std::atomic<long> live_;
+    // key * 1000 + something below 1000, a reader looking at a freed node breaks that
+    long value_;
+
+    explicit Tracked(long value = 0): value_(value) {
+        live_.fetch_add(1, std::memory_order_relaxed);
+    }
+    Tracked(const Tracked& other): value_(other.value_) {
+        live_.fetch_add(1, std::memory_order_relaxed);
+    }
+    Tracked& operator=(const Tracked& other) = default;
+    ~Tracked() {
+        live_.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+std::atomic<long> Tracked::live_{0};
+
+// a retired pointer that is still published in some hazard slot must survive try_to_clean. The dustbin used to compare
+// the address of its own bin node against the slots, which never matches, and deleted protected objects
+static void check_dustbin_respects_hazards() {
+    HazardDustbin dustbin(HazardPool::global());
+    std::atomic<void*>& hazard = ThreadHazardPointers<1>::get(0);
+    Tracked* protected_one = new Tracked(1);
+    Tracked* free_one = new Tracked(2);
+    long before = Tracked::live_.load();
+    hazard.store(protected_one);
+    dustbin.add_to_dustbin(protected_one);
+    dustbin.add_to_dustbin(free_one);
+    dustbin.try_to_clean();
+    MY_CHECK(Tracked::live_.load() == before - 1);
+    MY_CHECK(protected_one->value_ == 1);
+    hazard.store(nullptr);
+    dustbin.try_to_clean();
+    MY_CHECK(Tracked::live_.load() == before - 2);
+}
+
+// writers own the keys k with k % WRITER_NUM == t, so each knows exactly which of its keys are in the list, while the
+// few keys make them mark, unlink and help on each other's neighbours all the time
+static void check_concurrent_insert_erase_find() {
+    constexpr int WRITER_NUM = 4;
+    constexpr int READER_NUM = 2;
+    constexpr int KEY_NUM = 64;
+    constexpr int OP_NUM = 50000;
+
+    std::vector<std::vector<char>> present(WRITER_NUM, std::vector<char>(KEY_NUM, 0));
+    std::atomic<int> writers_left{WRITER_NUM};
+    {
+        MyLockFreeOrderedList<int, Tracked> list;
+        run_threads(WRITER_NUM + READER_NUM, [&](int t) {
+            MyXorShift rng(t);
+            if(t >= WRITER_NUM) {
+                while(writers_left.load(std::memory_order_acquire) > 0) {
+                    int key = static_cast<int>(rng.next() % KEY_NUM);
+                    Tracked found;
+                    if(list.find(key, found)) {
+                        MY_CHECK(found.value_ / 1000 == key);
+                    }
+                }
+                return;
+            }
+            std::vector<char>& mine = present[t];
+            for(int i = 0; i < OP_NUM; ++i) {
+                uint64_t r = rng.next();
+                int key = static_cast<int>((r >> 8) % (KEY_NUM / WRITER_NUM)) * WRITER_NUM + t;
+                switch(r % 4) {
+                    case 0:
+                        MY_CHECK(list.insert(key, Tracked(key * 1000L + i % 1000)) == !mine[key]);
+                        mine[key] = 1;
+                        break;
+                    case 1:
+                        MY_CHECK(list.erase(key) == static_cast<bool>(mine[key]));
+                        mine[key] = 0;
+                        break;
+                    case 2:
+                        MY_CHECK(list.contains(key) == static_cast<bool>(mine[key]));
+                        break;
+                    default: {
+                        Tracked found;
+                        bool exists = list.find(key, found);
+                        MY_CHECK(exists == static_cast<bool>(mine[key]));
+                        MY_CHECK(!exists || found.value_ / 1000 == key);
+                        break;
+                    }
+                }
+            }
+            writers_left.fetch_sub(1, std::memory_order_release);
+        });
+        for(int key = 0; key < KEY_NUM; ++key) {
+            MY_CHECK(list.contains(key) == static_cast<bool>(present[key % WRITER_NUM][key]));
+        }
+        // a key that was never inserted, the list is ordered so the search stops early
+        MY_CHECK(!list.contains(-1) && !list.contains(KEY_NUM));
+    }
+    // the destructor empties the dustbin, nothing may be left
+    MY_CHECK(Tracked::live_.load() == 0);
+}
+
+// every thread gives its three slots back when it exits, far more short lived threads than HazardPool has slots
+// must not run it dry
+static void check_hazard_slot_reuse() {
+    MyLockFreeOrderedList<int, Tracked> list;
+    for(int i = 0; i < 1000; ++i) {
+        std::thread([&list, i]() {
+            MY_CHECK(list.insert(i, Tracked(i * 1000L)));
+            MY_CHECK(list.erase(i));
+        }).join();
+    }
+    MY_CHECK(!list.contains(0));
+}
+
+int main() {
+    check_dustbin_respects_hazards();
+    check_concurrent_insert_erase_find();
+    check_hazard_slot_reuse();
+    std::printf("check_lock_free_ordered_list passed\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_hash_map/my_concurrent_lru_cache.h"
+
+using Cache = MyConcurrentLRUCache<int, long>;
+
+// the bound holds for any capacity, also one below the default number of shards
+static void check_capacity_bound() {
+    for(size_t capacity : {1, 4, 15, 16, 100, 1000}) {
+        Cache cache(capacity);
+        const int KEY_NUM = static_cast<int>(capacity) * 10;
+        for(int key = 0; key < KEY_NUM; ++key) {
+            cache.put(key, static_cast<long>(key));
+            MY_CHECK(cache.size() <= capacity);
+        }
+        Cache::Stats stats = cache.stats();
+        // every key was new, it either found room or pushed one out
+        MY_CHECK(stats.evictions_ == KEY_NUM - cache.size());
+        MY_CHECK(stats.expirations_ == 0);
+    }
+}
+
+// an entry past its ttl misses and is dropped, by the reader that finds it or by the eviction that reaches it
+static void check_expiry() {
+    using namespace std::chrono_literals;
+    Cache cache(100);
+    cache.put(1, 10L, 1ms);
+    cache.put(2, 20L);
+    std::this_thread::sleep_for(5ms);
+    long value = 0;
+    MY_CHECK(!cache.get(1, value));
+    MY_CHECK(cache.get(2, value) && value == 20);
+    Cache::Stats stats = cache.stats();
+    MY_CHECK(stats.expirations_ == 1 && stats.misses_ == 1 && stats.hits_ == 1);
+    MY_CHECK(cache.size() == 1);
+
+    // one slot: the expired entry is what the next put evicts, counted as an expiration
+    Cache single(1);
+    single.put(1, 10L, 1ms);
+    std::this_thread::sleep_for(5ms);
+    single.put(2, 20L);
+    stats = single.stats();
+    MY_CHECK(stats.expirations_ == 1 && stats.evictions_ == 0);
+    MY_CHECK(single.get(2, value) && value == 20 && !single.get(1, value));
+}
+
+/**
+ * One shard of two entries, both referenced. Replacing A must keep its referenced bit: the hand then clears B, clears
+ * A and evicts B on the next pass. A replacement that lost the bit would be evicted first instead.
+ */
+static void check_replace_keeps_recency() {
+    Cache cache(2, 1);
+    long value = 0;
+    cache.put(1, 10L);
+    cache.put(2, 20L);
+    MY_CHECK(cache.get(1, value) && cache.get(2, value));
+    cache.put(1, 11L);
+    cache.put(3, 30L);
+    MY_CHECK(cache.size() == 2);
+    MY_CHECK(!cache.get(2, value));
+    MY_CHECK(cache.get(1, value) && value == 11);
+    MY_CHECK(cache.get(3, value) && value == 30);
+}
+
+static void check_erase() {
+    Cache cache(16);
+    long value = 0;
+    cache.put(1, 10L);
+    cache.put(2, 20L);
+    MY_CHECK(cache.erase(1));
+    MY_CHECK(!cache.get(1, value) && cache.size() == 1);
+    MY_CHECK(!cache.erase(1));
+    // the slot is free again
+    cache.put(1, 12L);
+    MY_CHECK(cache.get(1, value) && value == 12 && cache.size() == 2);
+}
+
+// puts, gets, erases and short ttls from several threads: values stay right and the bound holds throughout
+static void check_concurrent() {
+    using namespace std::chrono_literals;
+    static constexpr size_t CAPACITY = 64;
+    static constexpr int KEY_NUM = 1000;
+    Cache cache(CAPACITY);
+    std::atomic<bool> stop{false};
+    std::atomic<long> wrong{0};
+    run_threads(5, [&](int t) {
+        if(t == 4) {
+            while(!stop.load()) {
+                MY_CHECK(cache.size() <= CAPACITY);
+            }
+            return;
+        }
+        MyXorShift rng(t);
+        for(int i = 0; i < 50000; ++i) {
+            uint64_t r = rng.next();
+            int key = static_cast<int>(r % KEY_NUM);
+            long value = 0;
+            switch((r >> 32) % 8) {
+            case 0:
+                cache.erase(key);
+                break;
+            case 1:
+                cache.put(key, static_cast<long>(key), 1us);
+                break;
+            case 2:
+                cache.put(key, static_cast<long>(key));
+                break;
+            default:
+                if(cache.get(key, value) && value != key) {
+                    wrong.fetch_add(1);
+                }
+            }
+        }
+        if(t == 0) {
+            stop.store(true);
+        }
+    });
+    MY_CHECK(wrong.load() == 0);
+    MY_CHECK(cache.size() <= CAPACITY);
+}
+
+int main() {
+    check_capacity_bound();
+    check_expiry();
+    check_replace_keeps_recency();
+    check_erase();
+    check_concurrent();
+    std::printf("check_lru_cache passed\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_forward_list/my_sync_forward_list.h"
+
+static std::vector<int> content(MySyncForwardList<int>& list) {
+    std::vector<int> ret;
+    list.for_each([&ret](int value) { ret.push_back(value); });
+    return ret;
+}
+
+// remove_first_if must unlink the element it matched, not the one behind it
+static void check_remove_first_if() {
+    MySyncForwardList<int> list;
+    for(int value : {5, 4, 3, 2, 1}) {
+        list.push_front(value);
+    }
+    MY_CHECK(list.remove_first_if([](int value) { return value == 3; }));
+    MY_CHECK((content(list) == std::vector<int>{1, 2, 4, 5}));
+    // the last element has nothing behind it
+    MY_CHECK(list.remove_first_if([](int value) { return value == 5; }));
+    MY_CHECK((content(list) == std::vector<int>{1, 2, 4}));
+    MY_CHECK(list.remove_first_if([](int value) { return value == 1; }));
+    MY_CHECK((content(list) == std::vector<int>{2, 4}));
+    MY_CHECK(!list.remove_first_if([](int value) { return value == 1; }));
+    MY_CHECK(list.remove_first_if([](int value) { return value % 2 == 0; }));
+    MY_CHECK((content(list) == std::vector<int>{4}));
+    MY_CHECK(list.remove_first_if([](int) { return true; }));
+    MY_CHECK(content(list).empty());
+    MY_CHECK(!list.remove_first_if([](int) { return true; }));
+}
+
+// every thread removes its own values while the others remove theirs from the same chain
+static void check_concurrent_remove() {
+    static constexpr int THREAD_NUM = 4;
+    constexpr int PER_THREAD = 500;
+    MySyncForwardList<int> list;
+    for(int value = 0; value < THREAD_NUM * PER_THREAD; ++value) {
+        list.push_front(value);
+    }
+    std::atomic<int> removed{0};
+    run_threads(THREAD_NUM, [&](int t) {
+        for(int i = 0; i < PER_THREAD; ++i) {
+            int target = i * THREAD_NUM + t;
+            MY_CHECK(list.remove_first_if([target](int value) { return value == target; }));
+            removed.fetch_add(1, std::memory_order_relaxed);
+        }
+        MY_CHECK(!list.remove_first_if([t](int value) { return value % THREAD_NUM == t; }));
+    });
+    MY_CHECK(removed.load() == THREAD_NUM * PER_THREAD);
+    MY_CHECK(content(list).empty());
+}
+
+int main() {
+    check_remove_first_if();
+    check_concurrent_remove();
+    std::printf("check_sync_forward_list passed\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_hash_map/my_sync_hash_map.h"
+
+// the key is moved into the node, comparing against it afterwards used to insert a duplicate of every rvalue key
+static void check_rvalue_key_update() {
+    MySyncHashMap<std::string, int> map;
+    MY_CHECK(map.insertOrUpdate(std::string("apple"), 1));
+    MY_CHECK(!map.insertOrUpdate(std::string("apple"), 2));
+    int value = 0;
+    MY_CHECK(map.getValue("apple", value) && value == 2);
+    MY_CHECK(map.eraseEntry("apple"));
+    MY_CHECK(!map.getValue("apple", value));
+}
+
+/**
+ * Writes with a std::string_view or a const char* key. A transparent map hashes and compares them as they are, any
+ * other map builds the std::string once up front. Lookups by string_view need a transparent map, the other one is
+ * asked with a std::string built from it.
+ */
+template <typename Map>
+static void check_foreign_keys(Map& map) {
+    std::string_view view("pear");
+    const char* c_str = "plum";
+    MY_CHECK(map.insertOrUpdate(view, 1));
+    MY_CHECK(!map.insertOrUpdate(view, 2));
+    MY_CHECK(map.insertOrUpdate(c_str, 3));
+    MY_CHECK(!map.insertOrUpdate(c_str, 4));
+    MY_CHECK(!map.upsert(view, [](int& value) { value += 10; }));
+    MY_CHECK(!map.upsert(c_str, [](int& value) { value += 10; }));
+    MY_CHECK(map.upsert(std::string_view("fig"), [](int& value) { value = 7; }));
+    MY_CHECK(map.upsert("kiwi", [](int& value) { value = 8; }));
+    int value = 0;
+    MY_CHECK(map.getValue(c_str, value) && value == 14);
+    MY_CHECK(map.getValue("fig", value) && value == 7);
+    MY_CHECK(map.getValue(std::string("kiwi"), value) && value == 8);
+    if constexpr (std::is_same_v<Map, MySyncHashMap<std::string, int, MyTransparentStringHash, std::equal_to<>>>) {
+        MY_CHECK(map.getValue(view, value) && value == 12);
+        MY_CHECK(map.contains(std::string_view("fig")));
+        MY_CHECK(map.eraseEntry(view));
+        MY_CHECK(!map.contains(view));
+    } else {
+        MY_CHECK(map.getValue(std::string(view), value) && value == 12);
+        MY_CHECK(map.eraseEntry(std::string(view)));
+        MY_CHECK(!map.contains(std::string(view)));
+    }
+    MY_CHECK(map.size() == 3);
+}
+
+// the bucket array doubles while writers and readers keep going, nothing may get lost on the way
+static void check_growth() {
+    constexpr int THREAD_NUM = 4;
+    constexpr int PER_THREAD = 20000;
+    MySyncHashMap<int, long> map(4);
+    run_threads(THREAD_NUM, [&](int t) {
+        for(int i = 0; i < PER_THREAD; ++i) {
+            int key = i * THREAD_NUM + t;
+            MY_CHECK(map.insertOrUpdate(key, key * 10L));
+            long value = 0;
+            MY_CHECK(map.getValue(key, value) && value == key * 10L);
+            // an older key of this thread, probably in a bucket that has moved meanwhile
+            int older = (i / 2) * THREAD_NUM + t;
+            MY_CHECK(map.getValue(older, value) && value == older * 10L);
+        }
+    });
+    // the load factor is 1, but a doubling only starts once the previous one is done and takes half as many writes as
+    // the table has buckets, so the current table may lag behind down to a third of the count
+    MY_CHECK(map.bucketCount() * 3 >= THREAD_NUM * PER_THREAD);
+    MY_CHECK(map.size() == THREAD_NUM * PER_THREAD);
+    for(int key = 0; key < THREAD_NUM * PER_THREAD; ++key) {
+        long value = 0;
+        MY_CHECK(map.getValue(key, value) && value == key * 10L);
+    }
+    MY_CHECK(!map.contains(THREAD_NUM * PER_THREAD));
+}
+
+static void check_snapshot_and_size() {
+    MySyncHashMap<int, long> map(8);
+    for(int key = 0; key < 1000; ++key) {
+        map.insertOrUpdate(key, key * 10L);
+    }
+    for(int key = 0; key < 1000; key += 3) {
+        MY_CHECK(map.eraseEntry(key));
+    }
+    map.insertOrUpdate(1, -1L);
+    std::vector<std::pair<int, long>> expected;
+    for(int key = 0; key < 1000; ++key) {
+        if(key % 3 != 0) {
+            expected.emplace_back(key, key == 1 ? -1L : key * 10L);
+        }
+    }
+    MY_CHECK(map.size() == expected.size());
+    auto entries = map.snapshot();
+    std::sort(entries.begin(), entries.end());
+    MY_CHECK(entries == expected);
+    size_t visited = 0;
+    map.for_each([&](int key, long value) {
+        MY_CHECK(key % 3 != 0 && value == (key == 1 ? -1L : key * 10L));
+        ++visited;
+    });
+    MY_CHECK(visited == expected.size());
+}
+
+// keys present during the whole for_each are seen exactly once with their value, while writers churn other keys
+// and keep the table resizing under the iteration
+static void check_for_each_under_writers() {
+    constexpr int STABLE_NUM = 2000;
+    constexpr int WRITER_NUM = 3;
+    constexpr int PER_WRITER = 30000;
+    MySyncHashMap<int, long> map(4);
+    for(int key = 0; key < STABLE_NUM; ++key) {
+        map.insertOrUpdate(key, key * 10L);
+    }
+    std::atomic<int> writers_left{WRITER_NUM};
+    std::atomic<int> passes{0};
+    run_threads(WRITER_NUM + 1, [&](int t) {
+        if(t == WRITER_NUM) {
+            std::vector<int> seen(STABLE_NUM);
+            while(writers_left.load(std::memory_order_acquire) > 0 || passes.load() == 0) {
+                std::fill(seen.begin(), seen.end(), 0);
+                map.for_each([&](int key, long value) {
+                    if(key < STABLE_NUM) {
+                        MY_CHECK(value == key * 10L);
+                        ++seen[key];
+                    } else {
+                        MY_CHECK(value == -key);
+                    }
+                });
+                for(int key = 0; key < STABLE_NUM; ++key) {
+                    MY_CHECK(seen[key] == 1);
+                }
+                passes.fetch_add(1);
+            }
+            return;
+        }
+        for(int i = 0; i < PER_WRITER; ++i) {
+            int key = STABLE_NUM + i * WRITER_NUM + t;
+            map.insertOrUpdate(key, static_cast<long>(-key));
+            if(i % 2 == 1) {
+                MY_CHECK(map.eraseEntry(key - WRITER_NUM));
+            }
+        }
+        writers_left.fetch_sub(1, std::memory_order_release);
+    });
+    MY_CHECK(map.size() == STABLE_NUM + WRITER_NUM * PER_WRITER / 2);
+    MY_CHECK(map.snapshot().size() == map.size());
+}
+
+// trivially copyable, so updates overwrite it in place while optimistic readers may be copying it. Wide enough that a
+// reader is often preempted halfway through its copy
+struct Wide {
+    long words_[64];
+};
+
+/**
+ * getValue reads chains without a lock and relies on the bucket version to catch a writer in between. Keys that are
+ * never erased must always be found, with a value some writer wrote as a whole: an in-place update of Wide must not
+ * be seen half done, an updated std::string must not be seen freed. Churn keys inserted and erased in the same few
+ * buckets and the resizes they cause keep unlinking the neighbours of the stable keys.
+ */
+template <typename VT, typename Make, typename Consistent>
+static void check_seqlock_readers(Make make, Consistent consistent) {
+    constexpr int STABLE_NUM = 8;
+    constexpr int WRITER_NUM = 2;
+    constexpr int READER_NUM = 3;
+    constexpr int OP_NUM = 40000;
+    MySyncHashMap<int, VT> map(2);
+    for(int key = 0; key < STABLE_NUM; ++key) {
+        map.insertOrUpdate(key, make(key, 0));
+    }
+    std::atomic<int> writers_left{WRITER_NUM};
+    run_threads(WRITER_NUM + READER_NUM, [&](int t) {
+        MyXorShift rng(t);
+        if(t >= WRITER_NUM) {
+            while(writers_left.load(std::memory_order_acquire) > 0) {
+                int key = static_cast<int>(rng.next() % STABLE_NUM);
+                VT value;
+                MY_CHECK(map.getValue(key, value));
+                MY_CHECK(consistent(key, value));
+            }
+            return;
+        }
+        for(int i = 1; i <= OP_NUM; ++i) {
+            uint64_t r = rng.next();
+            map.insertOrUpdate(static_cast<int>(r % STABLE_NUM), make(static_cast<int>(r % STABLE_NUM), i));
+            int churn = STABLE_NUM + static_cast<int>((r >> 16) % 64) * WRITER_NUM + t;
+            if(r & (1 << 8)) {
+                map.insertOrUpdate(churn, make(churn, i));
+            } else {
+                map.eraseEntry(churn);
+            }
+        }
+        writers_left.fetch_sub(1, std::memory_order_release);
+    });
+}
+
+int main() {
+    check_seqlock_readers<Wide>([](int key, long version) {
+        Wide wide;
+        std::fill(std::begin(wide.words_), std::end(wide.words_), key * 1000000L + version);
+        return wide;
+    }, [](int key, const Wide& wide) {
+        return wide.words_[0] / 1000000L == key &&
+            std::all_of(std::begin(wide.words_), std::end(wide.words_), [&wide](long word) {
+                return word == wide.words_[0];
+            });
+    });
+    check_seqlock_readers<std::string>([](int key, long version) {
+        // long enough to live on the heap
+        return std::string(40, static_cast<char>('a' + key)) + std::to_string(version);
+    }, [](int key, const std::string& str) {
+        return str.size() > 40 && str.find_first_not_of(static_cast<char>('a' + key)) == 40;
+    });
+    check_rvalue_key_update();
+    MySyncHashMap<std::string, int> plain_map;
+    check_foreign_keys(plain_map);
+    MySyncHashMap<std::string, int, MyTransparentStringHash, std::equal_to<>> transparent_map;
+    check_foreign_keys(transparent_map);
+    check_growth();
+    check_snapshot_and_size();
+    check_for_each_under_writers();
+    std::printf("check_sync_hash_map passed\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_sync_queue/my_sync_queue.h"
+
+// producers and consumers hand values over through a queue of capacity 1, so nearly every push has to wait for a pop
+// and every pop for a push. A lost wakeup on either side hangs the run, ctest kills it on its timeout
+static void check_capacity_one(bool blocking) {
+    constexpr int PRODUCER_NUM = 3;
+    constexpr int CONSUMER_NUM = 3;
+    constexpr int PER_PRODUCER = 20000;
+    constexpr int TOTAL = PRODUCER_NUM * PER_PRODUCER;
+    static_assert(TOTAL % CONSUMER_NUM == 0);
+
+    MySyncQueue<int> queue(1);
+    std::vector<std::atomic<int>> seen(TOTAL);
+    run_threads(PRODUCER_NUM + CONSUMER_NUM, [&](int t) {
+        if(t < PRODUCER_NUM) {
+            for(int i = 0; i < PER_PRODUCER; ++i) {
+                int value = t * PER_PRODUCER + i;
+                if(blocking) {
+                    MY_CHECK(queue.push(value));
+                } else {
+                    while(!queue.push_for(value, std::chrono::microseconds(50))) {
+                    }
+                }
+                MY_CHECK(queue.size() <= queue.capacity());
+            }
+            return;
+        }
+        // what a consumer gets from one producer must come in the order it was pushed
+        int last[PRODUCER_NUM];
+        std::fill(last, last + PRODUCER_NUM, -1);
+        for(int i = 0; i < TOTAL / CONSUMER_NUM; ++i) {
+            int value;
+            if(blocking) {
+                MY_CHECK(queue.pop(value));
+            } else {
+                std::shared_ptr<int> sptr;
+                while(!queue.tryPop(sptr)) {
+                    std::this_thread::yield();
+                }
+                value = *sptr;
+            }
+            MY_CHECK(value >= 0 && value < TOTAL);
+            MY_CHECK(value > last[value / PER_PRODUCER]);
+            last[value / PER_PRODUCER] = value;
+            seen[value].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    for(int i = 0; i < TOTAL; ++i) {
+        MY_CHECK(seen[i].load() == 1);
+    }
+    MY_CHECK(queue.size() == 0);
+    std::shared_ptr<int> sptr;
+    MY_CHECK(!queue.tryPop(sptr));
+}
+
+// a full queue rejects try_push, and close() releases a producer blocked on it
+static void check_full_and_close() {
+    MySyncQueue<int> queue(1);
+    MY_CHECK(queue.try_push(1));
+    MY_CHECK(!queue.try_push(2));
+    MY_CHECK(!queue.push_for(2, std::chrono::milliseconds(1)));
+    std::atomic<bool> pushed{true};
+    std::thread producer([&]() { pushed = queue.push(3); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.close();
+    producer.join();
+    MY_CHECK(!pushed);
+}
+
+int main() {
+    check_capacity_one(true);
+    check_capacity_one(false);
+    check_full_and_close();
+    std::printf("check_sync_queue passed\n");
+    return 0;
+}
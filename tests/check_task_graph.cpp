@@ -0,0 +1,205 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_thread_pool/my_task_graph.h"
+
+// a, then b and c, then d. Each node stamps the step it ran at, rerunning the graph must give the same order
+static void check_diamond(MyThreadPool& pool) {
+    std::atomic<int> clock{0};
+    int a = -1, b = -1, c = -1, d = -1;
+    TaskGraph graph;
+    TaskGraph::NodeId na = graph.add([&]() { a = clock.fetch_add(1); });
+    TaskGraph::NodeId nb = graph.add([&]() { b = clock.fetch_add(1); });
+    TaskGraph::NodeId nc = graph.add([&]() { c = clock.fetch_add(1); });
+    TaskGraph::NodeId nd = graph.add([&]() { d = clock.fetch_add(1); });
+    graph.precede(na, nb);
+    graph.precede(na, nc);
+    graph.precede(nb, nd);
+    graph.precede(nc, nd);
+    for(int run = 0; run < 1000; ++run) {
+        graph.run(pool);
+        const int base = run * 4;
+        MY_CHECK(a == base);
+        MY_CHECK(b > a && c > a && b != c);
+        MY_CHECK(d == base + 3);
+    }
+    MY_CHECK(clock.load() == 4000);
+}
+
+// layers of nodes, every node of a layer after every node of the one before. Checks every edge on each of the runs
+static void check_layers(MyThreadPool& pool) {
+    static constexpr int LAYER_NUM = 8;
+    static constexpr int WIDTH = 16;
+    std::atomic<int> clock{0};
+    std::vector<int> stamp(LAYER_NUM * WIDTH, -1);
+    TaskGraph graph;
+    for(int i = 0; i < LAYER_NUM * WIDTH; ++i) {
+        graph.add([&stamp, &clock, i]() { stamp[i] = clock.fetch_add(1); });
+    }
+    for(int layer = 1; layer < LAYER_NUM; ++layer) {
+        for(int from = 0; from < WIDTH; ++from) {
+            for(int to = 0; to < WIDTH; ++to) {
+                graph.precede((layer - 1) * WIDTH + from, layer * WIDTH + to);
+            }
+        }
+    }
+    for(int run = 0; run < 50; ++run) {
+        graph.run(pool);
+        for(int layer = 1; layer < LAYER_NUM; ++layer) {
+            for(int from = 0; from < WIDTH; ++from) {
+                for(int to = 0; to < WIDTH; ++to) {
+                    MY_CHECK(stamp[(layer - 1) * WIDTH + from] < stamp[layer * WIDTH + to]);
+                }
+            }
+        }
+    }
+    MY_CHECK(clock.load() == 50 * LAYER_NUM * WIDTH);
+}
+
+// a throwing node: run() rethrows it, what comes after it never runs, and the next run starts clean
+static void check_exception(MyThreadPool& pool) {
+    std::atomic<int> after{0};
+    bool fail = true;
+    TaskGraph graph;
+    TaskGraph::NodeId first = graph.add([]() {});
+    TaskGraph::NodeId thrower = graph.add([&fail]() {
+        if(fail) {
+            throw std::logic_error("node failed");
+        }
+    });
+    TaskGraph::NodeId last = graph.add([&after]() { after.fetch_add(1); });
+    graph.precede(first, thrower);
+    graph.precede(thrower, last);
+    for(int run = 0; run < 100; ++run) {
+        bool thrown = false;
+        try {
+            graph.run(pool);
+        } catch (const std::logic_error&) {
+            thrown = true;
+        }
+        MY_CHECK(thrown);
+    }
+    MY_CHECK(after.load() == 0);
+    fail = false;
+    graph.run(pool);
+    MY_CHECK(after.load() == 1);
+}
+
+static void check_cycle(MyThreadPool& pool) {
+    std::atomic<int> ran{0};
+    TaskGraph graph;
+    TaskGraph::NodeId root = graph.add([&ran]() { ran.fetch_add(1); });
+    TaskGraph::NodeId x = graph.add([&ran]() { ran.fetch_add(1); });
+    TaskGraph::NodeId y = graph.add([&ran]() { ran.fetch_add(1); });
+    graph.precede(root, x);
+    graph.precede(x, y);
+    graph.precede(y, x);
+    bool thrown = false;
+    try {
+        graph.run(pool);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    MY_CHECK(thrown);
+    MY_CHECK(ran.load() == 0);
+}
+
+// one worker and a queue of one task: the successors that do not fit run on the worker that made them ready, instead
+// of it waiting for room only it could make
+static void check_bounded_pool() {
+    static constexpr int WIDTH = 64;
+    MyThreadPool pool(1, 1);
+    std::atomic<int> ran{0};
+    TaskGraph graph;
+    TaskGraph::NodeId root = graph.add([&ran]() { ran.fetch_add(1); });
+    TaskGraph::NodeId sink = graph.add([&ran]() { ran.fetch_add(1); });
+    for(int i = 0; i < WIDTH; ++i) {
+        TaskGraph::NodeId middle = graph.add([&ran]() { ran.fetch_add(1); });
+        graph.precede(root, middle);
+        graph.precede(middle, sink);
+    }
+    for(int run = 1; run <= 200; ++run) {
+        graph.run(pool);
+        MY_CHECK(ran.load() == run * (WIDTH + 2));
+    }
+}
+
+// a stopped pool takes nothing: run() has to throw, not wait for nodes nobody will run. Once with the pool stopped
+// before the run, once with it stopped while the root runs, so its successors are refused from a worker
+static void check_stopped_pool() {
+    {
+        MyThreadPool pool(2);
+        pool.stopAll();
+        std::atomic<int> ran{0};
+        TaskGraph graph;
+        TaskGraph::NodeId a = graph.add([&ran]() { ran.fetch_add(1); });
+        TaskGraph::NodeId b = graph.add([&ran]() { ran.fetch_add(1); });
+        graph.add([&ran]() { ran.fetch_add(1); });
+        graph.precede(a, b);
+        bool thrown = false;
+        try {
+            graph.run(pool);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        MY_CHECK(thrown);
+        MY_CHECK(ran.load() == 0);
+    }
+    MyThreadPool pool(2);
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> ran{0};
+    TaskGraph graph;
+    TaskGraph::NodeId root = graph.add([&started, released]() {
+        started.set_value();
+        released.wait();
+    });
+    for(int i = 0; i < 4; ++i) {
+        graph.precede(root, graph.add([&ran]() { ran.fetch_add(1); }));
+    }
+    bool thrown = false;
+    std::thread runner([&]() {
+        try {
+            graph.run(pool);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+    });
+    started.get_future().wait();
+    // stopAll() waits for the root, which waits for us. Let the root go only once the pool refuses tasks
+    std::thread stopper([&pool]() { pool.stopAll(); });
+    while(true) {
+        try {
+            pool.try_post([]() {});
+        } catch (const std::runtime_error&) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    release.set_value();
+    runner.join();
+    stopper.join();
+    MY_CHECK(thrown);
+    MY_CHECK(ran.load() == 0);
+}
+
+int main() {
+    MyThreadPool pool(4);
+    check_diamond(pool);
+    check_layers(pool);
+    check_exception(pool);
+    check_cycle(pool);
+    check_bounded_pool();
+    check_stopped_pool();
+    std::puts("task graph checks passed");
+    return 0;
+}
@@ -0,0 +1,124 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+#include "my_check.h"
+#include "../sync_container_with_lock/my_thread_pool/my_thread_pool.h"
+
+/**
+ * One worker, held up by a first task until every level is filled, URGENT with far more tasks than the others. Then
+ * the order the worker ran them in must respect the documented bound: a level with tasks left is passed over at most
+ * limit + PRIORITY_NUM - 1 picks in a row, BULK included.
+ */
+static void check_aging_bound(uint32_t limit) {
+    constexpr int PER_LEVEL[MyThreadPool::PRIORITY_NUM] = {2000, 100, 100, 100};
+    MyThreadPool pool(1);
+    pool.set_aging_limit(limit);
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    pool.post([&started, released]() {
+        started.set_value();
+        released.wait();
+    });
+    // otherwise the worker could pick it up in between the others, a pick the order below would not show
+    started.get_future().wait();
+    // only the worker writes it, and stopAll() joins it before we read
+    std::vector<int> order;
+    for(int level = 0; level < MyThreadPool::PRIORITY_NUM; ++level) {
+        for(int i = 0; i < PER_LEVEL[level]; ++i) {
+            pool.post([&order, level]() { order.push_back(level); }, static_cast<MyThreadPool::Priority>(level));
+        }
+    }
+    release.set_value();
+    pool.stopAll();
+
+    int total = 0;
+    for(int n : PER_LEVEL) {
+        total += n;
+    }
+    MY_CHECK(static_cast<int>(order.size()) == total);
+    const int BOUND = static_cast<int>(limit) + MyThreadPool::PRIORITY_NUM - 1;
+    for(int level = 0; level < MyThreadPool::PRIORITY_NUM; ++level) {
+        int left = PER_LEVEL[level];
+        int passed_over = 0;
+        for(int ran : order) {
+            if(left == 0) {
+                break;
+            }
+            if(ran == level) {
+                --left;
+                passed_over = 0;
+            } else {
+                MY_CHECK(++passed_over <= BOUND);
+            }
+        }
+        MY_CHECK(left == 0);
+    }
+    // while all levels have tasks, a limit of 0 is strict round robin, the default leaves most picks to URGENT
+    int urgent_first = 0;
+    for(int i = 0; i < 100; ++i) {
+        urgent_first += order[i] == MyThreadPool::URGENT;
+    }
+    if(limit == 0) {
+        MY_CHECK(urgent_first == 25);
+    } else if(limit == 16) {
+        MY_CHECK(urgent_first >= 75);
+    }
+}
+
+// each level waited in the queue, and the stats saw every task
+static void check_wait_stats() {
+    MyThreadPool pool(2);
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 400; ++i) {
+        results.push_back(pool.submit([i]() { return i * 2; }, static_cast<MyThreadPool::Priority>(i % 4)));
+    }
+    for(int i = 0; i < 400; ++i) {
+        MY_CHECK(results[i].get() == i * 2);
+    }
+    auto stats = pool.wait_stats();
+    MY_CHECK(stats.size() == MyThreadPool::PRIORITY_NUM);
+    for(const auto& level : stats) {
+        MY_CHECK(level.tasks_ == 100);
+    }
+}
+
+// an elastic pool spawns for a burst, and once idle for longer than the timeout every worker above the minimum retires
+static void check_elastic_retirement() {
+    using namespace std::chrono_literals;
+    MyThreadPool pool(0, 4, 100ms);
+    MY_CHECK(pool.size() == 0 && pool.spawned_count() == 0);
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 200; ++i) {
+        results.push_back(pool.submit([i]() {
+            std::this_thread::sleep_for(100us);
+            return i;
+        }));
+    }
+    for(int i = 0; i < 200; ++i) {
+        MY_CHECK(results[i].get() == i);
+    }
+    MY_CHECK(pool.spawned_count() >= 1);
+    std::this_thread::sleep_for(300ms);
+    MY_CHECK(pool.size() == 0);
+    MY_CHECK(pool.retired_count() == pool.spawned_count());
+    // and the pool still works, it spawns again
+    MY_CHECK(pool.submit([]() { return 7; }).get() == 7);
+    MY_CHECK(pool.size() >= 1);
+}
+
+int main() {
+    check_elastic_retirement();
+    check_aging_bound(16);
+    check_aging_bound(4);
+    check_aging_bound(0);
+    check_wait_stats();
+    std::printf("check_thread_pool passed\n");
+    return 0;
+}
@@ -0,0 +1,49 @@
+//
+// Created by Charles Green on 11/10/25.
+//
+
+#ifndef MY_CHECK_H
+#define MY_CHECK_H
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// unlike assert() it stays on under NDEBUG, a check that fails ends the run with a non-zero exit code
+#define MY_CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::abort(); \
+        } \
+    } while(0)
+
+// xorshift64, a different stream for every seed, cheap enough to not show up next to the code under test
+struct MyXorShift {
+    uint64_t state_;
+
+    explicit MyXorShift(uint64_t seed): state_(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+};
+
+// func(t) on thread_num threads, t from 0, returns once all of them are done
+template <typename F>
+void run_threads(int thread_num, F&& func) {
+    std::vector<std::thread> threads;
+    threads.reserve(thread_num);
+    for(int t = 0; t < thread_num; ++t) {
+        threads.emplace_back([&func, t]() { func(t); });
+    }
+    for(auto& th : threads) {
+        th.join();
+    }
+}
+
+#endif //MY_CHECK_H